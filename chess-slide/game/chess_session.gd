@@ -4,8 +4,16 @@ extends Control
 @export var chess_board : Chess2D
 @export var wall_selection : WallSelection
 
+enum Player { LOCAL_HUMAN, ENGINE }
+
+@export var black_player := Player.LOCAL_HUMAN
+@export var engine_time_ms := 1000
+
 var _move_button_group := ButtonGroup.new()
 
+var _engine := ChessEngine.new()
+var _engine_fen := "" # The position the engine is thinking about, its move is dropped once the board moved on
+
 var ZERO_PATTERN := PackedVector2Array([
 	Vector2.ZERO, Vector2.ZERO, Vector2.ZERO, Vector2.ZERO,
 	Vector2.ZERO, Vector2.ZERO, Vector2.ZERO, Vector2.ZERO,
@@ -92,6 +100,9 @@ class Squares:
 
 
 func _ready() -> void:
+	_engine.move_found.connect(_engine_move_found)
+	chess_board.piece_moved.connect(_update_turn.unbind(3))
+
 	_piece_moved("*", "*", 0)
 	_show_wall_selection()
 
@@ -101,10 +112,11 @@ func _ready() -> void:
 
 
 func _show_wall_selection() -> void:
-	# TODO: Check that black is a local player
-	var is_black_local_human := true
+	var is_black_local_human := black_player == Player.LOCAL_HUMAN
+	var is_start := "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1" == chess_board.fen
 	chess_board.input_mode = Chess2D.INPUT_MODE_NONE
-	if is_black_local_human and "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1" == chess_board.fen:
+	_engine.cancel()
+	if is_black_local_human and is_start:
 		wall_selection.modulate = Color.WHITE
 		wall_selection.process_mode = Node.PROCESS_MODE_INHERIT
 		chess_board.modulate = Color.DARK_GRAY
@@ -112,6 +124,47 @@ func _show_wall_selection() -> void:
 		wall_selection.modulate = Color.TRANSPARENT
 		wall_selection.process_mode = Node.PROCESS_MODE_DISABLED
 		chess_board.modulate = Color.WHITE
+		if is_start:
+			# The engine plays black and picks the walls itself, after the board finished setting up
+			_break_square.call_deferred(Chess2D.field_to_square(randi_range(0, 7), randi_range(0, 7)))
+		else:
+			_update_turn()
+
+
+func _is_engine_turn() -> bool:
+	return black_player == Player.ENGINE and chess_board.fen.split(" ")[1] == "b"
+
+
+# An earlier ply picked from the move list, the engine only plays on from the latest one
+func _is_reviewing() -> bool:
+	var pressed := _move_button_group.get_pressed_button()
+	return pressed != null and pressed.get_index() != move_buttons.get_child_count() - 1
+
+
+# Hands the board to whoever moves next, the engine thinks in the background so the game keeps drawing
+func _update_turn() -> void:
+	if _is_reviewing():
+		# Its move would replace the plies after the one under review
+		_engine.cancel()
+		chess_board.input_mode = Chess2D.INPUT_MODE_NONE if _is_engine_turn() else Chess2D.INPUT_MODE_STANDARD
+	elif _is_engine_turn():
+		chess_board.input_mode = Chess2D.INPUT_MODE_NONE
+		_engine_fen = chess_board.fen
+		_engine.cancel()
+		_engine.search(chess_board, engine_time_ms)
+	else:
+		_engine.cancel()
+		chess_board.input_mode = Chess2D.INPUT_MODE_STANDARD
+
+
+# A move for a position the board has left is dropped and the position on the board is searched instead
+func _engine_move_found(uci_notation: String, _score: int, _depth: int) -> void:
+	if uci_notation.is_empty() or _is_reviewing():
+		return
+	if chess_board.fen != _engine_fen:
+		_update_turn()
+		return
+	chess_board.make_uci_move(uci_notation)
 
 
 func _flip_board() -> void:
@@ -119,6 +172,10 @@ func _flip_board() -> void:
 
 
 func _piece_moved(uci_notation: String, algebraic_notation: String, index: int) -> void:
+	# Moving while reviewing an earlier position replaces the moves after it
+	while move_buttons.get_child_count() > index:
+		move_buttons.get_child(move_buttons.get_child_count() - 1).free()
+
 	var button := Button.new()
 	button.text = algebraic_notation
 	button.button_group = _move_button_group
@@ -128,9 +185,16 @@ func _piece_moved(uci_notation: String, algebraic_notation: String, index: int)
 
 	button.pressed.connect(func():
 		chess_board.seek_position(index)
+		_update_turn()
 	)
 
 
+func _moves_loaded(uci_notations: PackedStringArray, algebraic_notations: PackedStringArray, first_index: int) -> void:
+	for i in algebraic_notations.size():
+		_piece_moved(uci_notations[i], algebraic_notations[i], first_index + i)
+	_update_turn()
+
+
 func _undo_last_move() -> void:
 	if move_buttons.get_child_count() <= 1:
 		return
@@ -147,6 +211,10 @@ func _undo_last_move() -> void:
 	_show_wall_selection()
 
 
+func _redo_move() -> void:
+	chess_board.redo_move()
+
+
 func _wall_selected(file: int, rank: int) -> void:
 	_break_square(Chess2D.field_to_square(file, rank, chess_board.is_flipped))
 
@@ -0,0 +1,97 @@
+# Streams simulated games between two replicators over a loopback TCP connection and checks they stay in step
+#
+# Usage: godot --headless --path chess-slide -s res://tools/replication_loopback.gd -- [games] [seed]
+extends SceneTree
+
+const MAX_PLIES := 120
+const DRIFT_INTERVAL := 50 # Every this many games the follower is changed behind the publisher's back
+
+var rng := RandomNumberGenerator.new()
+
+func _init() -> void:
+	var args := OS.get_cmdline_user_args()
+	var games := int(args[0]) if args.size() > 0 else 2000
+	rng.seed = int(args[1]) if args.size() > 1 else 1
+	quit(run(games))
+
+func run(games: int) -> int:
+	var server := TCPServer.new()
+	if server.listen(0, "127.0.0.1") != OK:
+		printerr("Could not listen on loopback")
+		return 1
+
+	var client := StreamPeerTCP.new()
+	client.connect_to_host("127.0.0.1", server.get_local_port())
+	var connection: StreamPeerTCP = null
+	while connection == null or client.get_status() != StreamPeerTCP.STATUS_CONNECTED:
+		client.poll()
+		if server.is_connection_available():
+			connection = server.take_connection()
+	client.set_no_delay(true)
+	connection.set_no_delay(true)
+
+	var published := ChessGame.new()
+	var followed := ChessGame.new()
+	var publisher := GameReplicator.new()
+	var follower := GameReplicator.new()
+	publisher.publish(published, connection)
+	follower.follow(followed, client)
+
+	var plies := 0
+	var mismatches := 0
+	var start := Time.get_ticks_usec()
+	for game in games:
+		published.set_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1")
+		published.set_walls(rng.randi_range(0, 63))
+
+		for ply in MAX_PLIES:
+			var moves := published.get_legal_moves()
+			if moves.is_empty() or published.is_threefold_repetition():
+				break
+
+			if game % DRIFT_INTERVAL == DRIFT_INTERVAL - 1 and ply == MAX_PLIES / 2:
+				followed.undo()
+
+			match rng.randi_range(0, 15):
+				0:
+					published.undo()
+				1 when published.has_walls():
+					published.slide(Vector2i([-2, 2].pick_random(), 0))
+				_:
+					published.make_move_code(moves[rng.randi_range(0, moves.size() - 1)])
+			plies += 1
+
+			exchange(publisher, follower, connection, client)
+
+		# Wait for the follower to catch up with the end of the game
+		for attempt in 100:
+			if follower.is_synced() and followed.hash() == published.hash():
+				break
+			if not exchange(publisher, follower, connection, client):
+				break
+		if followed.hash() != published.hash():
+			mismatches += 1
+
+	var seconds := (Time.get_ticks_usec() - start) / 1000000.0
+	print("%d games, %d plies in %.2fs" % [games, plies, seconds])
+	print("publisher sent %d bytes, %.2f per ply" % [publisher.get_bytes_sent(), float(publisher.get_bytes_sent()) / maxi(plies, 1)])
+	print("follower sent %d bytes, resynced %d times" % [follower.get_bytes_sent(), follower.get_resyncs()])
+	print("%d games ended out of step" % mismatches)
+
+	publisher.stop()
+	follower.stop()
+	return 0 if mismatches == 0 else 1
+
+# Polls both sides until neither has anything left to send, false when the connection broke
+func exchange(publisher: GameReplicator, follower: GameReplicator, connection: StreamPeerTCP, client: StreamPeerTCP) -> bool:
+	for attempt in 1000:
+		connection.poll()
+		client.poll()
+		if connection.get_status() != StreamPeerTCP.STATUS_CONNECTED or client.get_status() != StreamPeerTCP.STATUS_CONNECTED:
+			return false
+		if publisher.poll() != OK or follower.poll() != OK:
+			return false
+		if connection.get_available_bytes() == 0 and client.get_available_bytes() == 0 and follower.is_synced():
+			return true
+		OS.delay_usec(50)
+	return true
@@ -0,0 +1,307 @@
+#ifndef PHASE4_ENGINE_BOARD_ATTACK_MAPS_H
+#define PHASE4_ENGINE_BOARD_ATTACK_MAPS_H
+
+#include <phase4/engine/board/position.h>
+#include <phase4/engine/board/position_state.h>
+#include <phase4/engine/common/bitboard.h>
+#include <phase4/engine/common/field_index.h>
+#include <phase4/engine/common/piece_color.h>
+#include <phase4/engine/common/piece_type.h>
+#include <phase4/engine/common/square.h>
+
+#include <array>
+#include <cstdint>
+
+namespace phase4::engine::board {
+
+// Squares reached by pieces from a square, walls block sliders like any other occupied square
+// Tables are indexed by raw square values and built from field indexes so they follow the engine's square layout
+// Which way the pawns move is read from the engine's starting position rather than assumed
+class AttackMaps {
+public:
+	enum Direction {
+		NORTH,
+		SOUTH,
+		EAST,
+		WEST,
+		NORTH_EAST,
+		NORTH_WEST,
+		SOUTH_EAST,
+		SOUTH_WEST,
+		DIRECTIONS
+	};
+
+	static uint64_t knight(size_t square) {
+		return tables().knight[square];
+	}
+
+	static uint64_t king(size_t square) {
+		return tables().king[square];
+	}
+
+	// Squares a pawn of the color captures on
+	static uint64_t pawn(size_t square, common::PieceColor color) {
+		return tables().pawn[color.get_raw_value()][square];
+	}
+
+	// Squares a pawn of the color pushes to on an empty board, two from its starting rank
+	static uint64_t pawnPushes(size_t square, common::PieceColor color) {
+		return tables().pawnPushes[color.get_raw_value()][square];
+	}
+
+	static uint64_t bishop(size_t square, uint64_t occupancy) {
+		return ray(square, NORTH_EAST, occupancy) | ray(square, NORTH_WEST, occupancy) | ray(square, SOUTH_EAST, occupancy) | ray(square, SOUTH_WEST, occupancy);
+	}
+
+	static uint64_t rook(size_t square, uint64_t occupancy) {
+		return ray(square, NORTH, occupancy) | ray(square, SOUTH, occupancy) | ray(square, EAST, occupancy) | ray(square, WEST, occupancy);
+	}
+
+	static uint64_t queen(size_t square, uint64_t occupancy) {
+		return bishop(square, occupancy) | rook(square, occupancy);
+	}
+
+	// Squares strictly between two squares sharing a line, 0 when they do not share one
+	static uint64_t between(size_t from, size_t to) {
+		return tables().between[from][to];
+	}
+
+	// Every square of a rank counted from the side of white, 0 is the first rank of white
+	static uint64_t rank(size_t y) {
+		return tables().rank[y];
+	}
+
+	static uint64_t attacks(size_t square, common::PieceType type, common::PieceColor color, uint64_t occupancy) {
+		using namespace common;
+
+		switch (type.get_raw_value()) {
+			case PieceType::PAWN.get_raw_value():
+				return pawn(square, color);
+			case PieceType::KNIGHT.get_raw_value():
+				return knight(square);
+			case PieceType::BISHOP.get_raw_value():
+				return bishop(square, occupancy);
+			case PieceType::ROOK.get_raw_value():
+				return rook(square, occupancy);
+			case PieceType::QUEEN.get_raw_value():
+				return queen(square, occupancy);
+			case PieceType::KING.get_raw_value():
+				return king(square);
+		}
+		return 0;
+	}
+
+	static uint64_t occupancy(const Position &position, common::PieceColor color) {
+		using namespace common;
+
+		uint64_t pieces = 0;
+		for (PieceType type = PieceType::PAWN; type != PieceType::INVALID; ++type) {
+			pieces |= position.colorPieceMask(color, type).get_raw_value();
+		}
+		return pieces;
+	}
+
+	// Squares attacked by the pieces of the color when the board holds the given occupancy
+	static uint64_t attacked(const Position &position, common::PieceColor color, uint64_t occupancy) {
+		using namespace common;
+
+		uint64_t squares = 0;
+		for (PieceType type = PieceType::PAWN; type != PieceType::INVALID; ++type) {
+			uint64_t pieces = position.colorPieceMask(color, type).get_raw_value();
+			while (pieces != 0) {
+				squares |= attacks(lowest(pieces), type, color, occupancy);
+				pieces &= pieces - 1;
+			}
+		}
+		return squares;
+	}
+
+	static uint64_t attacked(const Position &position, common::PieceColor color) {
+		return attacked(position, color, position.occupancySummary().get_raw_value());
+	}
+
+	// Pieces of the opponent giving check to the king of the color
+	static uint64_t checkers(const Position &position, common::PieceColor color) {
+		using namespace common;
+
+		const uint64_t kings = position.colorPieceMask(color, PieceType::KING).get_raw_value();
+		if (kings == 0) {
+			return 0;
+		}
+
+		const size_t king = lowest(kings);
+		const PieceColor enemy = color.invert();
+		const uint64_t occupancy = position.occupancySummary().get_raw_value();
+		const uint64_t queens = position.colorPieceMask(enemy, PieceType::QUEEN).get_raw_value();
+		return (pawn(king, color) & position.colorPieceMask(enemy, PieceType::PAWN).get_raw_value()) |
+				(knight(king) & position.colorPieceMask(enemy, PieceType::KNIGHT).get_raw_value()) |
+				(bishop(king, occupancy) & (position.colorPieceMask(enemy, PieceType::BISHOP).get_raw_value() | queens)) |
+				(rook(king, occupancy) & (position.colorPieceMask(enemy, PieceType::ROOK).get_raw_value() | queens));
+	}
+
+	// Pieces of the color that can not leave the line between their king and an opposing slider
+	// When requested, the squares each pinned piece may still move to are written to pinRays
+	static uint64_t pinned(const Position &position, common::PieceColor color, std::array<uint64_t, 64> *pinRays = nullptr) {
+		using namespace common;
+
+		const uint64_t kings = position.colorPieceMask(color, PieceType::KING).get_raw_value();
+		if (kings == 0) {
+			return 0;
+		}
+
+		const size_t king = lowest(kings);
+		const PieceColor enemy = color.invert();
+		const uint64_t own = occupancy(position, color);
+		const uint64_t occupancy = position.occupancySummary().get_raw_value();
+		const uint64_t queens = position.colorPieceMask(enemy, PieceType::QUEEN).get_raw_value();
+		uint64_t sliders = (bishop(king, 0) & (position.colorPieceMask(enemy, PieceType::BISHOP).get_raw_value() | queens)) |
+				(rook(king, 0) & (position.colorPieceMask(enemy, PieceType::ROOK).get_raw_value() | queens));
+
+		uint64_t pins = 0;
+		while (sliders != 0) {
+			const size_t slider = lowest(sliders);
+			sliders &= sliders - 1;
+
+			const uint64_t blockers = between(king, slider) & occupancy;
+			if (blockers == 0 || (blockers & (blockers - 1)) != 0 || (blockers & own) == 0) {
+				continue;
+			}
+
+			pins |= blockers;
+			if (pinRays) {
+				(*pinRays)[lowest(blockers)] = between(king, slider) | (uint64_t(1) << slider);
+			}
+		}
+		return pins;
+	}
+
+	static size_t lowest(uint64_t squares) {
+		return common::Bitboard(squares).fastBitScan();
+	}
+
+	static size_t highest(uint64_t squares) {
+		size_t index = 0;
+		for (size_t shift = 32; shift > 0; shift >>= 1) {
+			if (squares >> shift) {
+				squares >>= shift;
+				index += shift;
+			}
+		}
+		return index;
+	}
+
+private:
+	struct Tables {
+		std::array<uint64_t, 64> knight;
+		std::array<uint64_t, 64> king;
+		std::array<std::array<uint64_t, 64>, 2> pawn;
+		std::array<std::array<uint64_t, 64>, 2> pawnPushes;
+		std::array<std::array<uint64_t, 64>, DIRECTIONS> rays;
+		std::array<bool, DIRECTIONS> ascending; // Whether raw square values grow along the direction
+		std::array<std::array<uint64_t, 64>, 64> between;
+		std::array<uint64_t, 8> rank;
+	};
+
+	static const Tables &tables() {
+		static const Tables tables = build();
+		return tables;
+	}
+
+	// Squares along a direction up to and including the first occupied one
+	static uint64_t ray(size_t square, Direction direction, uint64_t occupancy) {
+		const Tables &t = tables();
+		const uint64_t squares = t.rays[direction][square];
+		const uint64_t blockers = squares & occupancy;
+		if (blockers == 0) {
+			return squares;
+		}
+
+		const size_t blocker = t.ascending[direction] ? lowest(blockers) : highest(blockers);
+		return squares ^ t.rays[direction][blocker];
+	}
+
+	static bool onBoard(common::FieldIndex field) {
+		return field.x >= 0 && field.x < 8 && field.y >= 0 && field.y < 8;
+	}
+
+	static uint64_t bit(common::FieldIndex field) {
+		return uint64_t(1) << common::Square(field).get_raw_value();
+	}
+
+	// Squares reached by single steps from a square
+	template <size_t N>
+	static uint64_t steps(common::FieldIndex field, const std::array<common::FieldIndex, N> &offsets) {
+		uint64_t squares = 0;
+		for (const common::FieldIndex &offset : offsets) {
+			const common::FieldIndex target = field + offset;
+			if (onBoard(target)) {
+				squares |= bit(target);
+			}
+		}
+		return squares;
+	}
+
+	static Tables build() {
+		using namespace common;
+
+		static constexpr std::array<FieldIndex, DIRECTIONS> DIRECTION_STEPS = {
+			FieldIndex(0, 1), FieldIndex(0, -1), FieldIndex(1, 0), FieldIndex(-1, 0),
+			FieldIndex(1, 1), FieldIndex(-1, 1), FieldIndex(1, -1), FieldIndex(-1, -1)
+		};
+		static constexpr std::array<FieldIndex, 8> KNIGHT_STEPS = {
+			FieldIndex(1, 2), FieldIndex(2, 1), FieldIndex(2, -1), FieldIndex(1, -2),
+			FieldIndex(-1, -2), FieldIndex(-2, -1), FieldIndex(-2, 1), FieldIndex(-1, 2)
+		};
+
+		// White's king starts on white's first rank, its pawns move away from it
+		const int16_t whiteFirstRank = Square(PositionState::DEFAULT.colorPieceMask(PieceColor::WHITE, PieceType::KING)).asFieldIndex().y;
+		const int16_t forward = whiteFirstRank == 0 ? 1 : -1;
+		const std::array<FieldIndex, 2> whitePawnSteps = { FieldIndex(1, forward), FieldIndex(-1, forward) };
+		const std::array<FieldIndex, 2> blackPawnSteps = { FieldIndex(1, -forward), FieldIndex(-1, -forward) };
+
+		Tables t{};
+		const size_t white = PieceColor::WHITE.get_raw_value();
+		const size_t black = PieceColor::BLACK.get_raw_value();
+
+		for (int16_t y = 0; y < 8; ++y) {
+			for (int16_t x = 0; x < 8; ++x) {
+				const FieldIndex field(x, y);
+				const size_t square = Square(field).get_raw_value();
+				const int16_t rank = forward > 0 ? y : 7 - y; // Counted from the side of white
+
+				t.rank[rank] |= bit(field);
+				t.knight[square] = steps(field, KNIGHT_STEPS);
+				t.king[square] = steps(field, DIRECTION_STEPS);
+				t.pawn[white][square] = steps(field, whitePawnSteps);
+				t.pawn[black][square] = steps(field, blackPawnSteps);
+
+				if (rank < 7) {
+					t.pawnPushes[white][square] = bit(FieldIndex(x, y + forward)) | (rank == 1 ? bit(FieldIndex(x, y + 2 * forward)) : 0);
+				}
+				if (rank > 0) {
+					t.pawnPushes[black][square] = bit(FieldIndex(x, y - forward)) | (rank == 6 ? bit(FieldIndex(x, y - 2 * forward)) : 0);
+				}
+
+				for (size_t direction = 0; direction < DIRECTIONS; ++direction) {
+					uint64_t line = 0;
+					for (FieldIndex target = field + DIRECTION_STEPS[direction]; onBoard(target); target = target + DIRECTION_STEPS[direction]) {
+						t.between[square][Square(target).get_raw_value()] = line;
+						line |= bit(target);
+					}
+					t.rays[direction][square] = line;
+				}
+			}
+		}
+
+		const FieldIndex center(3, 3);
+		for (size_t direction = 0; direction < DIRECTIONS; ++direction) {
+			t.ascending[direction] = Square(center + DIRECTION_STEPS[direction]).get_raw_value() > Square(center).get_raw_value();
+		}
+
+		return t;
+	}
+};
+
+} //namespace phase4::engine::board
+
+#endif
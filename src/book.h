@@ -0,0 +1,270 @@
+#ifndef PHASE4_ENGINE_BOARD_BOOK_H
+#define PHASE4_ENGINE_BOARD_BOOK_H
+
+#include <phase4/engine/common/field_index.h>
+#include <phase4/engine/common/square.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace phase4::engine::board {
+
+// Read only view of a whole file, pages are loaded by the system as they are touched
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	~MappedFile() {
+		close();
+	}
+
+	bool open(const char *path) {
+		close();
+
+#ifdef _WIN32
+		const HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+
+		LARGE_INTEGER size;
+		const HANDLE mapping = GetFileSizeEx(file, &size) && size.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+		CloseHandle(file);
+		if (!mapping) {
+			return false;
+		}
+
+		m_data = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		CloseHandle(mapping);
+		m_size = m_data ? static_cast<size_t>(size.QuadPart) : 0;
+#else
+		const int file = ::open(path, O_RDONLY);
+		if (file < 0) {
+			return false;
+		}
+
+		struct stat status;
+		void *data = MAP_FAILED;
+		if (fstat(file, &status) == 0 && status.st_size > 0) {
+			data = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, file, 0);
+		}
+		::close(file);
+		if (data == MAP_FAILED) {
+			return false;
+		}
+
+		m_data = static_cast<const uint8_t *>(data);
+		m_size = status.st_size;
+#endif
+		return m_data != nullptr;
+	}
+
+	void close() {
+		if (!m_data) {
+			return;
+		}
+
+#ifdef _WIN32
+		UnmapViewOfFile(m_data);
+#else
+		munmap(const_cast<uint8_t *>(m_data), m_size);
+#endif
+		m_data = nullptr;
+		m_size = 0;
+	}
+
+	const uint8_t *data() const {
+		return m_data;
+	}
+
+	size_t size() const {
+		return m_size;
+	}
+
+private:
+	const uint8_t *m_data = nullptr;
+	size_t m_size = 0;
+};
+
+// Data about known positions stored as fixed size entries sorted by position hash
+// Files are written and read in the byte order of the machine, every supported platform is little endian
+class Book {
+public:
+	static constexpr uint32_t MAGIC = 0x4B423450; // P4BK
+	static constexpr uint32_t VERSION = 1;
+	static constexpr size_t MAX_MOVES = 4;
+	static constexpr uint16_t NO_MOVE = 0xFFFF;
+
+	struct Header {
+		uint32_t magic = MAGIC;
+		uint32_t version = VERSION;
+		uint64_t count = 0;
+	};
+
+	struct Entry {
+		uint64_t key = 0; // Position::hash()
+		uint32_t frequency = 0; // Times the position was seen
+		int16_t score = 0; // Centipawns for the side to move
+		uint16_t reserved = 0;
+		std::array<uint16_t, MAX_MOVES> moves = { NO_MOVE, NO_MOVE, NO_MOVE, NO_MOVE }; // Best first
+	};
+
+	static_assert(sizeof(Header) == 16 && sizeof(Entry) == 24, "Book records are read straight from the file");
+
+	// Moves are packed as from and to squares and the promotion piece, so reading needs no position
+	static uint16_t encodeMove(common::Square from, common::Square to, char promotion) {
+		static constexpr const char *PROMOTIONS = "nbrq";
+		const char *found = promotion ? std::strchr(PROMOTIONS, promotion) : nullptr;
+		const uint16_t piece = found ? static_cast<uint16_t>(found - PROMOTIONS + 1) : 0;
+		return static_cast<uint16_t>(from.get_raw_value() | (to.get_raw_value() << 6) | (piece << 12));
+	}
+
+	static std::string moveNotation(uint16_t move) {
+		static constexpr const char *PROMOTIONS = " nbrq";
+
+		std::string notation;
+		for (const size_t square : { move & 63, (move >> 6) & 63 }) {
+			const common::FieldIndex field = common::Square(square).asFieldIndex();
+			notation.push_back(static_cast<char>('a' + field.x));
+			notation.push_back(static_cast<char>('1' + field.y));
+		}
+		if ((move >> 12) != 0) {
+			notation.push_back(PROMOTIONS[(move >> 12) & 7]);
+		}
+		return notation;
+	}
+
+	// Maps the file, nothing beyond the header is read until looked up
+	bool open(const char *path) {
+		close();
+		return m_file.open(path) && attach(m_file.data(), m_file.size());
+	}
+
+	// Uses a book already in memory, the data must outlive the book
+	bool attach(const uint8_t *data, size_t size) {
+		Header header;
+		if (size < sizeof(header)) {
+			return false;
+		}
+		std::memcpy(&header, data, sizeof(header));
+		if (header.magic != MAGIC || header.version != VERSION || header.count != (size - sizeof(header)) / sizeof(Entry)) {
+			return false;
+		}
+
+		m_entries = reinterpret_cast<const Entry *>(data + sizeof(header));
+		m_count = header.count;
+		return true;
+	}
+
+	void close() {
+		m_file.close();
+		m_entries = nullptr;
+		m_count = 0;
+	}
+
+	size_t size() const {
+		return m_count;
+	}
+
+	// Hashes are spread evenly so interpolation lands close to the key, binary steps bound the worst case
+	const Entry *find(uint64_t key) const {
+		if (m_count == 0) {
+			return nullptr;
+		}
+
+		size_t low = 0;
+		size_t high = m_count - 1;
+		bool interpolate = true;
+		while (low <= high) {
+			const uint64_t lowKey = m_entries[low].key;
+			const uint64_t highKey = m_entries[high].key;
+			if (key < lowKey || key > highKey) {
+				return nullptr;
+			}
+
+			size_t middle = low + (high - low) / 2;
+			if (interpolate && highKey != lowKey) {
+				const double fraction = static_cast<double>(key - lowKey) / static_cast<double>(highKey - lowKey);
+				middle = low + static_cast<size_t>(fraction * (high - low));
+			}
+			interpolate = !interpolate;
+
+			const uint64_t middleKey = m_entries[middle].key;
+			if (middleKey == key) {
+				return &m_entries[middle];
+			} else if (middleKey < key) {
+				low = middle + 1;
+			} else if (middle == 0) {
+				return nullptr;
+			} else {
+				high = middle - 1;
+			}
+		}
+		return nullptr;
+	}
+
+	// Sorts the entries, merges those of the same position and writes them as a book
+	static bool write(std::FILE *file, std::vector<Entry> entries) {
+		std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+			return a.key < b.key;
+		});
+
+		std::vector<Entry> merged;
+		for (const Entry &entry : entries) {
+			if (merged.empty() || merged.back().key != entry.key) {
+				merged.push_back(entry);
+				continue;
+			}
+
+			Entry &target = merged.back();
+			const uint64_t frequency = uint64_t(target.frequency) + entry.frequency;
+			if (frequency != 0) {
+				target.score = static_cast<int16_t>((int64_t(target.score) * target.frequency + int64_t(entry.score) * entry.frequency) / int64_t(frequency));
+			}
+			target.frequency = static_cast<uint32_t>(std::min<uint64_t>(frequency, UINT32_MAX));
+
+			for (const uint16_t move : entry.moves) {
+				const auto end = std::find(target.moves.begin(), target.moves.end(), NO_MOVE);
+				if (move != NO_MOVE && end != target.moves.end() && std::find(target.moves.begin(), end, move) == end) {
+					*end = move;
+				}
+			}
+		}
+
+		Header header;
+		header.count = merged.size();
+		return std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+				(merged.empty() || std::fwrite(merged.data(), sizeof(Entry), merged.size(), file) == merged.size());
+	}
+
+private:
+	MappedFile m_file;
+	const Entry *m_entries = nullptr;
+	size_t m_count = 0;
+};
+
+} //namespace phase4::engine::board
+
+#endif
@@ -2,6 +2,7 @@
 
 #include <godot_cpp/classes/input_event_mouse_button.hpp>
 #include <godot_cpp/classes/input_event_mouse_motion.hpp>
+#include <godot_cpp/classes/project_settings.hpp>
 #include <godot_cpp/classes/ref.hpp>
 #include <godot_cpp/classes/time.hpp>
 #include <godot_cpp/core/class_db.hpp>
@@ -16,6 +17,8 @@
 #include <phase4/engine/fen/position_to_fen.h>
 
 #include <array>
+#include <cstring>
+#include <vector>
 
 using namespace godot;
 
@@ -31,6 +34,11 @@ void Chess2D::_bind_methods() {
 		ClassDB::add_property(class_name, PropertyInfo(Variant::STRING, fen_property), set_fen_method, get_fen_method);
 	}
 
+	{
+		const StringName load_stored_position_method = "load_stored_position";
+		ClassDB::bind_method(D_METHOD(load_stored_position_method, "store", "index"), &Chess2D::load_stored_position);
+	}
+
 	{
 		const StringName get_flipped_method = "get_flipped";
 		const StringName set_flipped_method = "set_flipped";
@@ -64,16 +72,86 @@ void Chess2D::_bind_methods() {
 		ClassDB::add_property(class_name, PropertyInfo(Variant::OBJECT, theme_property), set_theme_method, get_theme_method);
 	}
 
+	{
+		const StringName load_moves_method = "load_moves";
+		ClassDB::bind_method(D_METHOD(load_moves_method, "uci_notations"), &Chess2D::load_moves);
+	}
+
+	{
+		const StringName make_uci_move_method = "make_uci_move";
+		ClassDB::bind_method(D_METHOD(make_uci_move_method, "uci_notation"), &Chess2D::make_uci_move);
+	}
+
+	{
+		const StringName save_snapshot_method = "save_snapshot";
+		ClassDB::bind_method(D_METHOD(save_snapshot_method), &Chess2D::save_snapshot);
+	}
+
+	{
+		const StringName load_snapshot_method = "load_snapshot";
+		ClassDB::bind_method(D_METHOD(load_snapshot_method, "snapshot"), &Chess2D::load_snapshot);
+	}
+
+	{
+		const StringName start_journal_method = "start_journal";
+		ClassDB::bind_method(D_METHOD(start_journal_method, "path"), &Chess2D::start_journal);
+	}
+
+	{
+		const StringName stop_journal_method = "stop_journal";
+		ClassDB::bind_method(D_METHOD(stop_journal_method), &Chess2D::stop_journal);
+	}
+
+	{
+		const StringName recover_journal_method = "recover_journal";
+		ClassDB::bind_method(D_METHOD(recover_journal_method, "path"), &Chess2D::recover_journal);
+	}
+
 	{
 		const StringName undo_last_move_method = "undo_last_move";
 		ClassDB::bind_method(D_METHOD(undo_last_move_method), &Chess2D::undo_last_move);
 	}
 
+	{
+		const StringName redo_move_method = "redo_move";
+		ClassDB::bind_method(D_METHOD(redo_move_method), &Chess2D::redo_move);
+	}
+
+	{
+		const StringName is_threefold_repetition_method = "is_threefold_repetition";
+		ClassDB::bind_method(D_METHOD(is_threefold_repetition_method), &Chess2D::is_threefold_repetition);
+	}
+
 	{
 		const StringName seek_position_method = "seek_position";
 		ClassDB::bind_method(D_METHOD(seek_position_method, "index"), &Chess2D::seek_position);
 	}
 
+	{
+		const StringName get_history_notation_method = "get_history_notation";
+		ClassDB::bind_method(D_METHOD(get_history_notation_method), &Chess2D::get_history_notation);
+	}
+
+	{
+		const StringName get_variations_method = "get_variations";
+		ClassDB::bind_method(D_METHOD(get_variations_method), &Chess2D::get_variations);
+	}
+
+	{
+		const StringName get_attacked_squares_method = "get_attacked_squares";
+		ClassDB::bind_method(D_METHOD(get_attacked_squares_method, "color"), &Chess2D::get_attacked_squares);
+	}
+
+	{
+		const StringName get_pinned_pieces_method = "get_pinned_pieces";
+		ClassDB::bind_method(D_METHOD(get_pinned_pieces_method, "color"), &Chess2D::get_pinned_pieces);
+	}
+
+	{
+		const StringName get_checkers_method = "get_checkers";
+		ClassDB::bind_method(D_METHOD(get_checkers_method), &Chess2D::get_checkers);
+	}
+
 	{
 		const StringName break_square_method = "break_square";
 		ClassDB::bind_method(D_METHOD(break_square_method, "square_name"), &Chess2D::break_square);
@@ -94,6 +172,11 @@ void Chess2D::_bind_methods() {
 		ClassDB::bind_method(D_METHOD(clear_animation_offsets_method), &Chess2D::clear_animation_offsets);
 	}
 
+	{
+		const StringName get_move_cache_stats_method = "get_move_cache_stats";
+		ClassDB::bind_static_method(class_name, D_METHOD(get_move_cache_stats_method), &Chess2D::get_move_cache_stats);
+	}
+
 	{
 		const StringName field_to_square_method = "field_to_square";
 		ClassDB::bind_static_method(class_name, D_METHOD(field_to_square_method, "file", "rank", "flip"), &Chess2D::field_to_square, false);
@@ -105,25 +188,22 @@ void Chess2D::_bind_methods() {
 	}
 
 	ADD_SIGNAL(MethodInfo(StringName(SIGNAL_PIECE_MOVED), PropertyInfo(Variant::STRING, "uci_notation"), PropertyInfo(Variant::STRING, "algebraic_notation"), PropertyInfo(Variant::INT, "index")));
+	ADD_SIGNAL(MethodInfo(StringName(SIGNAL_MOVES_LOADED), PropertyInfo(Variant::PACKED_STRING_ARRAY, "uci_notations"), PropertyInfo(Variant::PACKED_STRING_ARRAY, "algebraic_notations"), PropertyInfo(Variant::INT, "first_index")));
 }
 
 bool Chess2D::_make_move(phase4::engine::moves::Move move) {
 	using namespace phase4::engine::moves;
 	using namespace phase4::engine::board;
 
-	const AlgebraicPieceAndSquareOffset &result = position.makeMove(move);
-	if (strcmp(result.algebraic_notation.data(), "") == 0) {
+	const std::optional<PieceAndSquareOffset> &result = position.makeMove(move);
+	if (!result) {
 		return false;
 	}
 
-	update_animation_offsets(result);
+	update_animation_offsets(*result);
 
-	godot::PackedByteArray algebraic_notation;
-	for (const char c : result.algebraic_notation) {
-		algebraic_notation.append(c);
-	}
-
-	emit_signal(StringName(SIGNAL_PIECE_MOVED), String(move.asUciNotation().data()), algebraic_notation.get_string_from_utf8(), static_cast<uint64_t>(position.size() - 1));
+	const uint64_t ply = position.size() - 1;
+	emit_signal(StringName(SIGNAL_PIECE_MOVED), String(move.asUciNotation().data()), String::utf8(position.notation(ply).data()), ply);
 	return true;
 }
 
@@ -360,27 +440,12 @@ void Chess2D::slide_squares(const Vector2i &direction) {
 	ERR_FAIL_COND(direction.x != 0 && direction.y != 0);
 	ERR_FAIL_COND(direction.x % 2 != 0 || direction.y % 2 != 0);
 
-	clear_animation_offsets();
-
-	Vector2i offset(0, 0);
-	const Vector2i step = direction.sign() * 2;
-	while (offset != direction) {
-		Bitboard walls = position.current().walls();
-		while (walls != 0) {
-			const Square wall(walls);
-			int32_t scale = is_flipped ? 1 : -1;
-			square_animation_offsets[wall] = scale * step.sign() * theme->get_square_size();
-
-			const FieldIndex target_field = wall.asFieldIndex();
-			const int field_mod = is_flipped ? 0 : 1;
-			if (target_field.x % 2 == field_mod && target_field.y % 2 != field_mod) {
-				slide_trail_end[wall] = get_square_position(wall) + scale * step * theme->get_square_size();
-			}
-
-			walls = walls.popLsb();
-		}
-		offset += step;
-		position.slideWalls(FieldIndex(step.x, step.y));
+	const std::optional<phase4::engine::board::PieceAndSquareOffset> result = position.slideWallsBy(FieldIndex(direction.x, direction.y));
+	if (result) {
+		// The offsets run every square the walls crossed back to where it was before the whole slide,
+		// so update_animation_offsets sets the wall trail for each step of the slide
+		clear_animation_offsets();
+		update_animation_offsets(*result);
 	}
 }
 
@@ -398,6 +463,16 @@ void Chess2D::set_target_offsets(const PackedVector2Array &p_offsets) {
 	}
 }
 
+Dictionary Chess2D::get_move_cache_stats() {
+	using namespace phase4::engine::board;
+
+	const MoveCache &cache = MoveCache::shared();
+	Dictionary stats;
+	stats["hits"] = cache.hits();
+	stats["misses"] = cache.misses();
+	return stats;
+}
+
 godot::String Chess2D::field_to_square(int file, int rank, bool flip = false) {
 	using namespace phase4::engine::common;
 
@@ -587,18 +662,22 @@ void Chess2D::_draw() {
 		valid_move_squares_canvas_item.clear();
 
 		if (const std::optional<Square> &from = get_selected()) {
-			const FastVector<Move, 21> &moves = position.validMoves(*from);
-			for (size_t i = 0; i < moves.size(); ++i) {
-				const Move move = moves[i];
-				const Transform2D transform = Transform2D().translated(get_square_position(move.to()));
-				valid_circle_multimeshes.set_instance_transform_2d(i, transform);
-				valid_square_multimesh->set_instance_transform_2d(i, transform);
+			Bitboard destinations = position.validDestinations(*from);
+			int32_t instance = 0;
+			while (destinations != 0) {
+				const Square to(destinations);
+				destinations = destinations.popLsb();
+
+				const Transform2D transform = Transform2D().translated(get_square_position(to));
+				valid_circle_multimeshes.set_instance_transform_2d(instance, transform);
+				valid_square_multimesh->set_instance_transform_2d(instance, transform);
+				++instance;
 			}
 
-			valid_circle_multimeshes.set_visible_instance_count(moves.size());
+			valid_circle_multimeshes.set_visible_instance_count(instance);
 			valid_circle_multimeshes.add_multimesh(*valid_move_circles_canvas_item);
 
-			valid_square_multimesh->set_visible_instance_count(moves.size());
+			valid_square_multimesh->set_visible_instance_count(instance);
 			valid_move_squares_canvas_item.add_multimesh(*valid_square_multimesh.ptr());
 		}
 	}
@@ -686,7 +765,7 @@ void Chess2D::_draw() {
 		king_danger_canvas_item.clear();
 		const Square dragged_square = get_dragged();
 		for (PieceColor piece_color = PieceColor::WHITE; piece_color != PieceColor::INVALID; ++piece_color) {
-			if (position.current().colorToMove() == piece_color && position.current().isKingChecked(piece_color)) {
+			if (position.current().colorToMove() == piece_color && position.checkers() != 0) {
 				king_danger_canvas_item.add_rect(Rect2(get_square_position(Square(position.current().colorPieceMask(piece_color, PieceType::KING))), square_size), Color(1.0, 1.0, 1.0, 1.0));
 			}
 			for (PieceType piece_type = PieceType::PAWN; piece_type != PieceType::INVALID; ++piece_type) {
@@ -703,7 +782,7 @@ void Chess2D::_draw() {
 						continue;
 					}
 
-					const Color color = position.validMoves(square).is_empty() ? Color("GRAY") : Color("WHITE");
+					const Color color = position.validDestinations(square) == 0 ? Color("GRAY") : Color("WHITE");
 					mesh->set_instance_color(instance, color);
 					const Vector2 piece_offset = piece_animation_offsets[square] + half_square_size;
 					mesh->set_instance_transform_2d(instance, Transform2D().translated(get_square_position(square) + piece_offset));
@@ -731,15 +810,9 @@ void Chess2D::_draw() {
 					// Show valid squares for selected piece
 					const Square start_square(FieldIndex(selected_square->x, 7 - selected_square->y));
 					const Square flipped_start_square = is_flipped ? start_square.flipped() : start_square;
-					hover_canvas_item = &invalid_hover_canvas_item;
-					FastVector<Move, 21> valid_moves = position.validMoves(flipped_start_square);
-					for (size_t i = 0; i < valid_moves.size(); ++i) {
-						if (valid_moves[i].from() == flipped_start_square && valid_moves[i].to() == flipped_target_square) {
-							hover_canvas_item = &valid_hover_canvas_item;
-						}
-					}
+					hover_canvas_item = position.isValidMove(flipped_start_square, flipped_target_square) ? &valid_hover_canvas_item : &invalid_hover_canvas_item;
 				} else {
-					hover_canvas_item = position.validMoves(flipped_target_square).is_empty() ? &invalid_hover_canvas_item : &valid_hover_canvas_item;
+					hover_canvas_item = position.validDestinations(flipped_target_square) == 0 ? &invalid_hover_canvas_item : &valid_hover_canvas_item;
 				}
 				hover_canvas_item->add_mesh(*theme->get_highlight_mesh().ptr(), godot::Transform2D().translated(start_position + highlighted_square.value() * theme->get_square_size()));
 			}
@@ -842,10 +915,11 @@ void Chess2D::_input(const Ref<InputEvent> &event) {
 		if (mouse_button->get_button_index() == MOUSE_BUTTON_LEFT) {
 			if (mouse_button->is_pressed()) {
 				if (const std::optional<Square> &to = get_mouse_square()) {
-					if (const std::optional<Square> &from = get_selected()) {
+					const std::optional<Square> &from = get_selected();
+					if (from && position.isValidMove(*from, *to)) {
 						_make_move(Move(*from, *to, MoveFlags::QUIET));
 					}
-					if (position.validMoves(*to).is_empty()) {
+					if (position.validDestinations(*to) == 0) {
 						selected_square.reset();
 						draw_flags |= DrawFlags::HIGHLIGHT | DrawFlags::VALID_MOVES;
 						queue_redraw();
@@ -867,7 +941,8 @@ void Chess2D::_input(const Ref<InputEvent> &event) {
 				queue_redraw();
 
 				if (const std::optional<Square> &to = get_mouse_square()) {
-					if (const std::optional<Square> &from = get_selected()) {
+					const std::optional<Square> &from = get_selected();
+					if (from && position.isValidMove(*from, *to)) {
 						if (_make_move(Move(*from, *to, MoveFlags::QUIET))) {
 							selected_square.reset();
 							draw_flags |= DrawFlags::HIGHLIGHT | DrawFlags::VALID_MOVES;
@@ -922,6 +997,21 @@ void Chess2D::set_fen(const String &fen) {
 	}
 }
 
+const phase4::engine::board::Position &Chess2D::get_current_position() const {
+	return position.current();
+}
+
+// Loads a position that the store validated ahead of time
+void Chess2D::load_stored_position(const Ref<PositionStore> &store, int64_t index) {
+	ERR_FAIL_COND_MSG(store.is_null(), "No position store");
+	const std::optional<phase4::engine::board::Position> stored = store->get_position(index);
+	ERR_FAIL_COND(!stored);
+	position.reset(*stored);
+	if (is_inside_tree()) {
+		clear_animation_offsets();
+	}
+}
+
 Ref<ChessTheme> Chess2D::get_theme() const {
 	return theme;
 }
@@ -952,13 +1042,259 @@ void Chess2D::set_flipped(bool flipped) {
 	clear_animation_offsets();
 }
 
+// Applies moves from the viewed position without animations, stops at the first invalid move
+// A single signal reports the loaded moves and the board is redrawn once
+int64_t Chess2D::load_moves(const PackedStringArray &uci_notations) {
+	using namespace phase4::engine::board;
+	using namespace phase4::engine::common;
+	using namespace phase4::engine::moves;
+
+	PackedStringArray loaded_uci_notations;
+	PackedStringArray algebraic_notations;
+	for (int64_t i = 0; i < uci_notations.size(); ++i) {
+		const String &uci_notation = uci_notations[i];
+
+		// Matched against the viewed ply that makeMove plays from, promotions need their piece
+		const std::optional<Move> valid_move = position.findUciMove(uci_notation.ascii().get_data());
+		ERR_BREAK_MSG(!valid_move, "Invalid move: " + uci_notation);
+		Move move = *valid_move;
+		ERR_BREAK_MSG(!position.makeMove(move), "Invalid move: " + uci_notation);
+
+		loaded_uci_notations.push_back(String(move.asUciNotation().data()));
+	}
+
+	if (loaded_uci_notations.is_empty()) {
+		return 0;
+	}
+
+	const uint64_t first_index = position.size() - loaded_uci_notations.size();
+	position.generateNotations();
+	algebraic_notations.resize(loaded_uci_notations.size());
+	for (int64_t i = 0; i < algebraic_notations.size(); ++i) {
+		algebraic_notations.set(i, String::utf8(position.notation(first_index + i).data()));
+	}
+
+	selected_square.reset();
+	drag_piece.reset();
+	draw_flags |= DrawFlags::ALL;
+	if (is_inside_tree()) {
+		clear_animation_offsets();
+	}
+	queue_redraw();
+
+	emit_signal(StringName(SIGNAL_MOVES_LOADED), loaded_uci_notations, algebraic_notations, first_index);
+	return loaded_uci_notations.size();
+}
+
+// Plays a move chosen somewhere else, like a move made with the mouse it is animated and reported with piece_moved
+bool Chess2D::make_uci_move(const String &uci_notation) {
+	using namespace phase4::engine::board;
+	using namespace phase4::engine::common;
+	using namespace phase4::engine::moves;
+
+	const std::optional<Move> move = position.findUciMove(uci_notation.ascii().get_data());
+	ERR_FAIL_COND_V_MSG(!move || !_make_move(*move), false, "Invalid move: " + uci_notation);
+
+	selected_square.reset();
+	drag_piece.reset();
+	draw_flags |= DrawFlags::HIGHLIGHT | DrawFlags::VALID_MOVES | DrawFlags::PIECES;
+	queue_redraw();
+	return true;
+}
+
+// The game followed by the annotations, written with a single allocation
+PackedByteArray Chess2D::save_snapshot() const {
+	const size_t game_size = position.snapshotSize();
+	const uint32_t annotation_count = annotations.size();
+
+	PackedByteArray snapshot;
+	snapshot.resize(game_size + sizeof(annotation_count) + annotation_count * sizeof(uint16_t));
+	uint8_t *data = snapshot.ptrw();
+	position.writeSnapshot(data);
+	data += game_size;
+
+	memcpy(data, &annotation_count, sizeof(annotation_count));
+	data += sizeof(annotation_count);
+	for (const uint16_t annotation : annotations) {
+		memcpy(data, &annotation, sizeof(annotation));
+		data += sizeof(annotation);
+	}
+	return snapshot;
+}
+
+// Restores a snapshot from save_snapshot, the board is left unchanged when it is not valid
+bool Chess2D::load_snapshot(const PackedByteArray &snapshot) {
+	const uint8_t *data = snapshot.ptr();
+	const size_t size = snapshot.size();
+
+	// The header gives where the annotations start, restore checks the game itself
+	const size_t game_size = phase4::engine::board::PositionView::snapshotSize(data, size);
+	ERR_FAIL_COND_V_MSG(game_size == 0 || size - game_size < sizeof(uint32_t), false, "Invalid snapshot");
+
+	uint32_t annotation_count;
+	memcpy(&annotation_count, data + game_size, sizeof(annotation_count));
+	ERR_FAIL_COND_V_MSG(size - game_size - sizeof(annotation_count) < annotation_count * sizeof(uint16_t), false, "Invalid snapshot");
+
+	// Annotations are a from and to square each
+	const uint8_t *annotation_data = data + game_size + sizeof(annotation_count);
+	for (uint32_t i = 0; i < annotation_count; ++i) {
+		uint16_t annotation;
+		memcpy(&annotation, annotation_data + i * sizeof(annotation), sizeof(annotation));
+		ERR_FAIL_COND_V_MSG(annotation >= 64 * 64, false, "Invalid snapshot");
+	}
+
+	ERR_FAIL_COND_V_MSG(position.restore(data, game_size) == 0, false, "Invalid snapshot");
+
+	annotations.clear();
+	for (uint32_t i = 0; i < annotation_count; ++i) {
+		uint16_t annotation;
+		memcpy(&annotation, annotation_data + i * sizeof(annotation), sizeof(annotation));
+		annotations.insert(annotation);
+	}
+
+	selected_square.reset();
+	drag_piece.reset();
+	draw_flags |= DrawFlags::ALL;
+	if (is_inside_tree()) {
+		clear_animation_offsets();
+	}
+	queue_redraw();
+	return true;
+}
+
+// Writes the game to the path and appends every following change to it
+Error Chess2D::start_journal(const String &path) {
+	stop_journal();
+
+	std::vector<uint8_t> base(position.snapshotSize());
+	position.writeSnapshot(base.data());
+
+	const String global_path = ProjectSettings::get_singleton()->globalize_path(path);
+	ERR_FAIL_COND_V_MSG(!journal.begin(global_path.utf8().get_data(), base.data(), base.size()), ERR_CANT_CREATE, "Could not create journal " + path);
+	position.setJournal(&journal);
+	return OK;
+}
+
+void Chess2D::stop_journal() {
+	position.setJournal(nullptr);
+	journal.close();
+}
+
+// Rebuilds the game written by a journal that was not stopped, then keeps journaling to the same path
+bool Chess2D::recover_journal(const String &path) {
+	using namespace phase4::engine::board;
+
+	const String global_path = ProjectSettings::get_singleton()->globalize_path(path);
+	const std::optional<MoveJournal::Contents> &contents = MoveJournal::read(global_path.utf8().get_data());
+	ERR_FAIL_COND_V_MSG(!contents, false, "Invalid journal " + path);
+
+	stop_journal();
+	ERR_FAIL_COND_V_MSG(!position.replay(*contents), false, "Invalid journal " + path);
+	start_journal(path);
+
+	selected_square.reset();
+	drag_piece.reset();
+	draw_flags |= DrawFlags::ALL;
+	if (is_inside_tree()) {
+		clear_animation_offsets();
+	}
+	queue_redraw();
+	return true;
+}
+
 void Chess2D::undo_last_move() {
-	const phase4::engine::board::PieceAndSquareOffset &result = position.undo();
-	update_animation_offsets(result);
+	const std::optional<phase4::engine::board::PieceAndSquareOffset> result = position.undo();
+	if (!result) {
+		return;
+	}
+
+	draw_flags |= DrawFlags::VALID_MOVES | DrawFlags::HIGHLIGHT;
+	update_animation_offsets(*result);
+}
+
+bool Chess2D::redo_move() {
+	using namespace phase4::engine::board;
+
+	const std::optional<PieceAndSquareOffset> result = position.redo();
+	if (!result) {
+		return false;
+	}
+
+	draw_flags |= DrawFlags::VALID_MOVES | DrawFlags::HIGHLIGHT;
+	update_animation_offsets(*result);
+
+	const uint64_t ply = position.size() - 1;
+	emit_signal(StringName(SIGNAL_PIECE_MOVED), String(position.currentMove().asUciNotation().data()), String::utf8(position.notation(ply).data()), ply);
+	return true;
+}
+
+// Whether the latest position occurred three times, walls included
+bool Chess2D::is_threefold_repetition() const {
+	return position.isThreefoldRepetition();
 }
 
 void Chess2D::seek_position(uint64_t index) {
-	update_animation_offsets(position.seek(index));
+	const std::optional<phase4::engine::board::PieceAndSquareOffset> result = position.seek(index);
+	if (!result) {
+		return;
+	}
+
+	draw_flags |= DrawFlags::VALID_MOVES | DrawFlags::HIGHLIGHT;
+	update_animation_offsets(*result);
+}
+
+// Notation of every ply after the start, walls placed on the board have empty notation
+Dictionary Chess2D::get_history_notation() {
+	position.generateNotations();
+
+	PackedStringArray algebraic_notations;
+	PackedStringArray uci_notations;
+	algebraic_notations.resize(position.size() - 1);
+	uci_notations.resize(position.size() - 1);
+	for (size_t ply = 1; ply < position.size(); ++ply) {
+		const phase4::engine::moves::Move move = position.move(ply);
+		algebraic_notations.set(ply - 1, String::utf8(position.notation(ply).data()));
+		uci_notations.set(ply - 1, move == phase4::engine::moves::Move::EMPTY ? String() : String(move.asUciNotation().data()));
+	}
+
+	Dictionary history;
+	history["algebraic"] = algebraic_notations;
+	history["uci"] = uci_notations;
+	return history;
+}
+
+PackedStringArray Chess2D::get_variations() const {
+	using namespace phase4::engine::common;
+	using namespace phase4::engine::moves;
+
+	FastVector<Move, 64> moves;
+	position.variations(moves);
+
+	PackedStringArray uci_notations;
+	uci_notations.resize(moves.size());
+	for (size_t i = 0; i < moves.size(); ++i) {
+		uci_notations.set(i, String(moves[i].asUciNotation().data()));
+	}
+	return uci_notations;
+}
+
+// Bitboards of the viewed position with a bit per square, worked out once per ply for overlays
+int64_t Chess2D::get_attacked_squares(int64_t color) const {
+	using namespace phase4::engine::common;
+
+	ERR_FAIL_COND_V(color < 0 || color > 1, 0);
+	return static_cast<int64_t>(position.attackedSquares(PieceColor(static_cast<uint8_t>(color))).get_raw_value());
+}
+
+int64_t Chess2D::get_pinned_pieces(int64_t color) const {
+	using namespace phase4::engine::common;
+
+	ERR_FAIL_COND_V(color < 0 || color > 1, 0);
+	return static_cast<int64_t>(position.pinnedPieces(PieceColor(static_cast<uint8_t>(color))).get_raw_value());
+}
+
+int64_t Chess2D::get_checkers() const {
+	return static_cast<int64_t>(position.checkers().get_raw_value());
 }
 
 void Chess2D::set_theme(const Ref<ChessTheme> &theme) {
@@ -3,6 +3,7 @@
 
 #include "canvas_item_util.h"
 #include "chess_theme.h"
+#include "position_store.h"
 #include "position_view.h" // TODO: Move into phase4::engine::board
 
 #include <godot_cpp/classes/input_event.hpp>
@@ -45,6 +46,7 @@ public:
 
 private:
 	inline static const char *SIGNAL_PIECE_MOVED = "piece_moved";
+	inline static const char *SIGNAL_MOVES_LOADED = "moves_loaded";
 
 	bool _make_move(phase4::engine::moves::Move move);
 
@@ -62,6 +64,7 @@ private:
 	std::unordered_set<uint16_t> annotations;
 
 	phase4::engine::board::PositionView position;
+	phase4::engine::board::MoveJournal journal;
 
 	CanvasItemUtil flourish_canvas_item;
 	CanvasItemUtil square_trail_canvas_item;
@@ -110,6 +113,7 @@ public:
 
 	String get_fen() const;
 	void set_fen(const String &fen);
+	void load_stored_position(const Ref<PositionStore> &store, int64_t index);
 
 	bool get_flipped() const;
 	void set_flipped(bool flipped);
@@ -117,14 +121,29 @@ public:
 	InputMode get_input_mode() const;
 	void set_input_mode(InputMode mode);
 
+	int64_t load_moves(const PackedStringArray &uci_notations);
+	bool make_uci_move(const String &uci_notation);
+	PackedByteArray save_snapshot() const;
+	bool load_snapshot(const PackedByteArray &snapshot);
+	Error start_journal(const String &path);
+	void stop_journal();
+	bool recover_journal(const String &path);
 	void undo_last_move();
+	bool redo_move();
+	bool is_threefold_repetition() const;
 	void seek_position(uint64_t index);
+	Dictionary get_history_notation();
+	PackedStringArray get_variations() const;
+	int64_t get_attacked_squares(int64_t color) const;
+	int64_t get_pinned_pieces(int64_t color) const;
+	int64_t get_checkers() const;
 
 	Ref<ChessTheme> get_theme() const;
 	void set_theme(const Ref<ChessTheme> &theme);
 	void theme_changed();
 
 	Vector2 get_square_position(phase4::engine::common::Square square);
+	const phase4::engine::board::Position &get_current_position() const;
 
 	std::optional<phase4::engine::common::Square> get_selected();
 
@@ -144,6 +163,8 @@ public:
 
 	void set_target_offsets(const PackedVector2Array &p_offsets);
 
+	static Dictionary get_move_cache_stats();
+
 	static godot::String field_to_square(int file, int rank, bool flip);
 	static Vector2i square_to_field(const godot::String &square_name, bool flip);
 };
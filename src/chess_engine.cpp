@@ -0,0 +1,198 @@
+#include "chess_engine.h"
+
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/project_settings.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/core/property_info.hpp>
+#include <godot_cpp/variant/callable_method_pointer.hpp>
+
+#include <memory>
+
+using namespace godot;
+
+void ChessEngine::_bind_methods() {
+	const StringName class_name = "ChessEngine";
+
+	{
+		const StringName get_max_depth_method = "get_max_depth";
+		const StringName set_max_depth_method = "set_max_depth";
+		const StringName max_depth_property = "max_depth";
+		ClassDB::bind_method(D_METHOD(get_max_depth_method), &ChessEngine::get_max_depth);
+		ClassDB::bind_method(D_METHOD(set_max_depth_method, max_depth_property), &ChessEngine::set_max_depth);
+		ClassDB::add_property(class_name, PropertyInfo(Variant::INT, max_depth_property), set_max_depth_method, get_max_depth_method);
+	}
+
+	{
+		const StringName get_hash_size_method = "get_hash_size";
+		const StringName set_hash_size_method = "set_hash_size";
+		const StringName hash_size_property = "hash_size";
+		ClassDB::bind_method(D_METHOD(get_hash_size_method), &ChessEngine::get_hash_size);
+		ClassDB::bind_method(D_METHOD(set_hash_size_method, hash_size_property), &ChessEngine::set_hash_size);
+		ClassDB::add_property(class_name, PropertyInfo(Variant::INT, hash_size_property), set_hash_size_method, get_hash_size_method);
+	}
+
+	{
+		const StringName search_method = "search";
+		ClassDB::bind_method(D_METHOD(search_method, "board", "time_ms"), &ChessEngine::search);
+	}
+
+	{
+		const StringName search_game_method = "search_game";
+		ClassDB::bind_method(D_METHOD(search_game_method, "game", "time_ms"), &ChessEngine::search_game);
+	}
+
+	{
+		const StringName cancel_method = "cancel";
+		ClassDB::bind_method(D_METHOD(cancel_method), &ChessEngine::cancel);
+	}
+
+	{
+		const StringName is_searching_method = "is_searching";
+		ClassDB::bind_method(D_METHOD(is_searching_method), &ChessEngine::is_searching);
+	}
+
+	{
+		const StringName clear_hash_method = "clear_hash";
+		ClassDB::bind_method(D_METHOD(clear_hash_method), &ChessEngine::clear_hash);
+	}
+
+	{
+		const StringName add_tablebase_method = "add_tablebase";
+		ClassDB::bind_method(D_METHOD(add_tablebase_method, "path"), &ChessEngine::add_tablebase);
+	}
+
+	{
+		const StringName clear_tablebase_method = "clear_tablebase";
+		ClassDB::bind_method(D_METHOD(clear_tablebase_method), &ChessEngine::clear_tablebase);
+	}
+
+	ADD_SIGNAL(MethodInfo(StringName(SIGNAL_MOVE_FOUND), PropertyInfo(Variant::STRING, "uci_notation"), PropertyInfo(Variant::INT, "score"), PropertyInfo(Variant::INT, "depth")));
+}
+
+ChessEngine::~ChessEngine() {
+	if (task != -1) {
+		cancelled = true;
+		WorkerThreadPool::get_singleton()->wait_for_task_completion(task);
+	}
+}
+
+Error ChessEngine::start(const phase4::engine::board::Position &position, int64_t time_ms) {
+	ERR_FAIL_COND_V(time_ms < 1, ERR_INVALID_PARAMETER);
+	if (task != -1 && cancelled) {
+		// A cancelled search stops within a few nodes, its finish is ignored by the generation
+		WorkerThreadPool::get_singleton()->wait_for_task_completion(task);
+		task = -1;
+	}
+	ERR_FAIL_COND_V_MSG(is_searching(), ERR_BUSY, "The engine is already searching.");
+
+	root = position;
+	result = phase4::engine::board::Search::Result();
+	limits.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(time_ms);
+	limits.maxDepth = static_cast<int32_t>(max_depth);
+	limits.cancelled = &cancelled;
+
+	cancelled = false;
+	++generation;
+	task = WorkerThreadPool::get_singleton()->add_task(callable_mp(this, &ChessEngine::think).bind(generation), false, "ChessEngine");
+	return OK;
+}
+
+// Runs on a worker thread, only the task touches the table and the result until finish waited for it
+void ChessEngine::think(uint64_t search_generation) {
+	using namespace phase4::engine::board;
+
+	std::unique_ptr<Search> search = std::make_unique<Search>(table);
+	search->setTablebase(tablebase.tables() > 0 ? &tablebase : nullptr);
+	result = search->run(root, limits);
+
+	callable_mp(this, &ChessEngine::finish).call_deferred(search_generation);
+}
+
+void ChessEngine::finish(uint64_t search_generation) {
+	if (task == -1 || search_generation != generation) {
+		return; // Replaced by a newer search
+	}
+
+	WorkerThreadPool::get_singleton()->wait_for_task_completion(task);
+	task = -1;
+	if (cancelled) {
+		return; // The position was left behind, nobody wants this move
+	}
+
+	const String uci_notation = result.move ? String(result.move->asUciNotation().data()) : String();
+	emit_signal(StringName(SIGNAL_MOVE_FOUND), uci_notation, result.score, result.depth);
+}
+
+void ChessEngine::set_max_depth(int64_t depth) {
+	ERR_FAIL_COND(depth < 1 || depth >= int64_t(phase4::engine::board::Search::MAX_PLY));
+	max_depth = depth;
+}
+
+int64_t ChessEngine::get_max_depth() const {
+	return max_depth;
+}
+
+void ChessEngine::set_hash_size(int64_t megabytes) {
+	ERR_FAIL_COND_MSG(is_searching(), "The hash size can not change during a search.");
+	ERR_FAIL_COND(megabytes < 1 || megabytes > 4096);
+	hash_size = megabytes;
+	table.resize(size_t(megabytes) * 1024 * 1024);
+}
+
+int64_t ChessEngine::get_hash_size() const {
+	return hash_size;
+}
+
+// Thinks about the position shown on the board, the board is free to change while the engine thinks
+Error ChessEngine::search(Chess2D *board, int64_t time_ms) {
+	ERR_FAIL_NULL_V(board, ERR_INVALID_PARAMETER);
+	return start(board->get_current_position(), time_ms);
+}
+
+Error ChessEngine::search_game(const Ref<ChessGame> &game, int64_t time_ms) {
+	ERR_FAIL_COND_V(game.is_null(), ERR_INVALID_PARAMETER);
+	return start(game->get_position().current(), time_ms);
+}
+
+// The search stops within a few nodes and move_found is not emitted for it, a new search can start right away
+void ChessEngine::cancel() {
+	if (task != -1) {
+		cancelled = true;
+	}
+}
+
+bool ChessEngine::is_searching() const {
+	return task != -1;
+}
+
+void ChessEngine::clear_hash() {
+	ERR_FAIL_COND_MSG(is_searching(), "The hash can not be cleared during a search.");
+	table.clear();
+}
+
+// Endings of the table are played perfectly, a table of the same material and format replaces the one added before
+Error ChessEngine::add_tablebase(const String &path) {
+	ERR_FAIL_COND_V_MSG(is_searching(), ERR_BUSY, "Tables can not be added during a search.");
+
+	const String global_path = ProjectSettings::get_singleton()->globalize_path(path);
+	if (tablebase.open(global_path.utf8().get_data())) {
+		return OK;
+	}
+
+	const PackedByteArray bytes = FileAccess::get_file_as_bytes(path);
+	const Error error = FileAccess::get_open_error();
+	ERR_FAIL_COND_V_MSG(error != OK, error, "Could not open " + path);
+	tablebase_bytes.push_back(bytes);
+	if (!tablebase.attach(tablebase_bytes.back().ptr(), tablebase_bytes.back().size())) {
+		tablebase_bytes.pop_back();
+		ERR_FAIL_V_MSG(ERR_FILE_CORRUPT, "Invalid tablebase: " + path);
+	}
+	return OK;
+}
+
+void ChessEngine::clear_tablebase() {
+	ERR_FAIL_COND_MSG(is_searching(), "Tables can not be removed during a search.");
+	tablebase.close();
+	tablebase_bytes.clear();
+}
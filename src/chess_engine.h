@@ -0,0 +1,66 @@
+#ifndef CHESSENGINE_H
+#define CHESSENGINE_H
+
+#include "chess2d.h"
+#include "chess_game.h"
+#include "search.h"
+#include "tablebase.h"
+#include "transposition_table.h"
+
+#include <godot_cpp/classes/ref_counted.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+namespace godot {
+
+// An opponent that thinks on a WorkerThreadPool task while the game keeps running
+// A search is started for a position, move_found is emitted on the main thread once the time is up
+class ChessEngine : public RefCounted {
+	GDCLASS(ChessEngine, RefCounted)
+
+public:
+	inline static const char *SIGNAL_MOVE_FOUND = "move_found";
+
+private:
+	int64_t max_depth = 32;
+	int64_t hash_size = 16; // Megabytes
+
+	phase4::engine::board::TranspositionTable table{ 16 * 1024 * 1024 }; // Kept between searches, the next move reuses what was found
+	phase4::engine::board::Tablebase tablebase;
+	std::vector<PackedByteArray> tablebase_bytes; // Tables that could not be mapped, such as those in a pack
+	phase4::engine::board::Position root;
+	phase4::engine::board::Search::Limits limits;
+	phase4::engine::board::Search::Result result; // Written by the task, read once it completed
+	int64_t task = -1;
+	uint64_t generation = 0; // Tells the finish of a replaced search apart from the current one
+	std::atomic<bool> cancelled{ false };
+
+	Error start(const phase4::engine::board::Position &position, int64_t time_ms);
+	void think(uint64_t search_generation);
+	void finish(uint64_t search_generation);
+
+protected:
+	static void _bind_methods();
+
+public:
+	~ChessEngine();
+
+	void set_max_depth(int64_t depth);
+	int64_t get_max_depth() const;
+	void set_hash_size(int64_t megabytes);
+	int64_t get_hash_size() const;
+
+	Error search(Chess2D *board, int64_t time_ms);
+	Error search_game(const Ref<ChessGame> &game, int64_t time_ms);
+	void cancel();
+	bool is_searching() const;
+	void clear_hash();
+	Error add_tablebase(const String &path);
+	void clear_tablebase();
+};
+
+} //namespace godot
+
+#endif
@@ -0,0 +1,222 @@
+#include "chess_game.h"
+
+#include <godot_cpp/core/class_db.hpp>
+
+#include <phase4/engine/fen/fen_to_position.h>
+#include <phase4/engine/fen/position_to_fen.h>
+
+#include <optional>
+
+using namespace godot;
+
+ChessGame::ChessGame() {
+	position.setOverlays(false);
+}
+
+void ChessGame::_bind_methods() {
+	const StringName class_name = "ChessGame";
+
+	{
+		const StringName move_code_to_uci_method = "move_code_to_uci";
+		ClassDB::bind_static_method(class_name, D_METHOD(move_code_to_uci_method, "code"), &ChessGame::move_code_to_uci);
+	}
+
+	{
+		const StringName get_fen_method = "get_fen";
+		const StringName set_fen_method = "set_fen";
+		ClassDB::bind_method(D_METHOD(get_fen_method), &ChessGame::get_fen);
+		ClassDB::bind_method(D_METHOD(set_fen_method, "fen"), &ChessGame::set_fen);
+	}
+
+	{
+		const StringName get_legal_moves_method = "get_legal_moves";
+		ClassDB::bind_method(D_METHOD(get_legal_moves_method), &ChessGame::get_legal_moves);
+	}
+
+	{
+		const StringName make_move_code_method = "make_move_code";
+		ClassDB::bind_method(D_METHOD(make_move_code_method, "code"), &ChessGame::make_move_code);
+	}
+
+	{
+		const StringName undo_method = "undo";
+		ClassDB::bind_method(D_METHOD(undo_method), &ChessGame::undo);
+	}
+
+	{
+		const StringName get_ply_method = "get_ply";
+		ClassDB::bind_method(D_METHOD(get_ply_method), &ChessGame::get_ply);
+	}
+
+	{
+		const StringName hash_method = "hash";
+		ClassDB::bind_method(D_METHOD(hash_method), &ChessGame::hash);
+	}
+
+	{
+		const StringName is_check_method = "is_check";
+		ClassDB::bind_method(D_METHOD(is_check_method), &ChessGame::is_check);
+	}
+
+	{
+		const StringName is_threefold_repetition_method = "is_threefold_repetition";
+		ClassDB::bind_method(D_METHOD(is_threefold_repetition_method), &ChessGame::is_threefold_repetition);
+	}
+
+	{
+		const StringName has_walls_method = "has_walls";
+		ClassDB::bind_method(D_METHOD(has_walls_method), &ChessGame::has_walls);
+	}
+
+	{
+		const StringName set_walls_method = "set_walls";
+		ClassDB::bind_method(D_METHOD(set_walls_method, "square"), &ChessGame::set_walls);
+	}
+
+	{
+		const StringName slide_method = "slide";
+		ClassDB::bind_method(D_METHOD(slide_method, "direction"), &ChessGame::slide);
+	}
+}
+
+int32_t ChessGame::encode_move(phase4::engine::moves::Move move) {
+	return move.from().get_raw_value() | (move.to().get_raw_value() << 6) | (move.flags().get_raw_value() << 12);
+}
+
+phase4::engine::moves::Move ChessGame::decode_move(int32_t code) {
+	using namespace phase4::engine::common;
+	using namespace phase4::engine::moves;
+
+	return Move(Square(static_cast<size_t>(code & 63)), Square(static_cast<size_t>((code >> 6) & 63)), MoveFlags(static_cast<uint8_t>((code >> 12) & 0xF)));
+}
+
+// Promotions end with their piece, the flags of the code tell which
+String ChessGame::move_code_to_uci(int32_t code) {
+	ERR_FAIL_COND_V_MSG(code < 0 || code > 0xFFFF, String(), "Invalid move code");
+	return String(decode_move(code).asUciNotation().data());
+}
+
+bool ChessGame::set_fen(const String &fen) {
+	using namespace phase4::engine::board;
+	using namespace phase4::engine::fen;
+
+	const std::optional<Position> &parsedPosition = FenToPosition::parse(fen.ascii().get_data());
+	ERR_FAIL_COND_V_MSG(!parsedPosition, false, "Invalid fen: " + fen);
+	position.reset(*parsedPosition);
+	legal_moves_valid = false;
+	return true;
+}
+
+String ChessGame::get_fen() const {
+	using namespace phase4::engine::fen;
+
+	const std::string &fen = PositionToFen::encode(position.current());
+	return String(fen.c_str());
+}
+
+// Returns the same array until the position changes, so repeated calls do not allocate
+PackedInt32Array ChessGame::get_legal_moves() {
+	if (!legal_moves_valid) {
+		const phase4::engine::moves::Moves &moves = position.validMoves();
+		legal_moves.resize(moves.size());
+		int32_t *codes = legal_moves.ptrw();
+		for (size_t i = 0; i < moves.size(); ++i) {
+			codes[i] = encode_move(moves[i]);
+		}
+		legal_moves_valid = true;
+	}
+	return legal_moves;
+}
+
+bool ChessGame::make_move_code(int32_t code) {
+	using namespace phase4::engine::board;
+	using namespace phase4::engine::common;
+	using namespace phase4::engine::moves;
+
+	ERR_FAIL_COND_V_MSG(code < 0 || code > 0xFFFF, false, "Invalid move code");
+
+	const PositionView::SquareMoves &square_moves = position.validMoves(Square(static_cast<size_t>(code & 63)));
+	for (size_t i = 0; i < square_moves.size(); ++i) {
+		if (encode_move(square_moves[i]) == code) {
+			Move move = square_moves[i];
+			legal_moves_valid = false;
+			return position.makeMove(move).has_value();
+		}
+	}
+	return false;
+}
+
+bool ChessGame::undo() {
+	if (!position.undo()) {
+		return false;
+	}
+
+	legal_moves_valid = false;
+	return true;
+}
+
+int64_t ChessGame::get_ply() const {
+	return position.size() - 1;
+}
+
+int64_t ChessGame::hash() const {
+	return static_cast<int64_t>(position.current().hash().get_raw_value());
+}
+
+bool ChessGame::is_check() const {
+	const phase4::engine::board::Position &current = position.current();
+	return current.isKingChecked(current.colorToMove());
+}
+
+bool ChessGame::is_threefold_repetition() const {
+	return position.isThreefoldRepetition();
+}
+
+bool ChessGame::has_walls() const {
+	return position.current().walls() != 0;
+}
+
+// Places the walls with their corner on the square, walls can only be placed once
+bool ChessGame::set_walls(int32_t square) {
+	using namespace phase4::engine::common;
+
+	ERR_FAIL_INDEX_V(square, 64, false);
+	const size_t ply = position.size();
+	position.setWalls(Square(static_cast<size_t>(square)));
+	legal_moves_valid = false;
+	return position.size() != ply;
+}
+
+// Slides the walls along one axis by an even number of squares, like Chess2D.slide_squares
+bool ChessGame::slide(const Vector2i &direction) {
+	using namespace phase4::engine::common;
+
+	ERR_FAIL_COND_V(position.current().walls() == 0, false);
+	ERR_FAIL_COND_V(direction.x != 0 && direction.y != 0, false);
+	ERR_FAIL_COND_V(direction.x % 2 != 0 || direction.y % 2 != 0, false);
+
+	if (!position.slideWallsBy(FieldIndex(direction.x, direction.y))) {
+		return false;
+	}
+
+	legal_moves_valid = false;
+	return true;
+}
+
+const phase4::engine::board::PositionView &ChessGame::get_position() const {
+	return position;
+}
+
+void ChessGame::set_record_sink(phase4::engine::board::RecordSink *sink) {
+	position.setRecordSink(sink);
+}
+
+bool ChessGame::apply_record(const phase4::engine::board::MoveJournal::Record &record) {
+	legal_moves_valid = false;
+	return position.apply(record);
+}
+
+bool ChessGame::restore_snapshot(const uint8_t *data, size_t size) {
+	legal_moves_valid = false;
+	return position.restore(data, size) != 0;
+}
@@ -0,0 +1,56 @@
+#ifndef CHESSGAME_H
+#define CHESSGAME_H
+
+#include "position_view.h"
+
+#include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+
+namespace godot {
+
+// A game without a board to draw it, for bots, servers and tests
+// Its view keeps no board overlays and does not share moves through MoveCache
+// Moves are passed as codes holding the from square, to square and flags: from | to << 6 | flags << 12
+class ChessGame : public RefCounted {
+	GDCLASS(ChessGame, RefCounted)
+
+private:
+	phase4::engine::board::PositionView position;
+	PackedInt32Array legal_moves; // Codes of the latest position, filled when first requested
+	bool legal_moves_valid = false;
+
+protected:
+	static void _bind_methods();
+
+public:
+	ChessGame();
+
+	static int32_t encode_move(phase4::engine::moves::Move move);
+	static phase4::engine::moves::Move decode_move(int32_t code);
+	static String move_code_to_uci(int32_t code);
+
+	bool set_fen(const String &fen);
+	String get_fen() const;
+
+	PackedInt32Array get_legal_moves();
+	bool make_move_code(int32_t code);
+	bool undo();
+
+	int64_t get_ply() const;
+	int64_t hash() const;
+	bool is_check() const;
+	bool is_threefold_repetition() const;
+
+	bool has_walls() const;
+	bool set_walls(int32_t square);
+	bool slide(const Vector2i &direction);
+
+	const phase4::engine::board::PositionView &get_position() const;
+	void set_record_sink(phase4::engine::board::RecordSink *sink);
+	bool apply_record(const phase4::engine::board::MoveJournal::Record &record);
+	bool restore_snapshot(const uint8_t *data, size_t size);
+};
+
+} //namespace godot
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef PHASE4_ENGINE_BOARD_ENGINE_LOG_H
+#define PHASE4_ENGINE_BOARD_ENGINE_LOG_H
+
+#include <atomic>
+#include <cstdio>
+
+namespace phase4::engine::board {
+
+// Warnings of the engine headers, which do not depend on Godot
+// The extension routes them to WARN_PRINT, the native tools print them to stderr
+class EngineLog {
+public:
+	using Handler = void (*)(const char *message);
+
+	// nullptr restores printing to stderr
+	static void setHandler(Handler handler) {
+		handlerSlot().store(handler ? handler : printToStderr, std::memory_order_release);
+	}
+
+	static void warn(const char *message) {
+		handlerSlot().load(std::memory_order_acquire)(message);
+	}
+
+private:
+	static void printToStderr(const char *message) {
+		std::fprintf(stderr, "WARNING: %s\n", message);
+	}
+
+	static std::atomic<Handler> &handlerSlot() {
+		static std::atomic<Handler> handler{ printToStderr };
+		return handler;
+	}
+};
+
+} //namespace phase4::engine::board
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef PHASE4_ENGINE_BOARD_EPD_H
+#define PHASE4_ENGINE_BOARD_EPD_H
+
+#include <phase4/engine/board/position.h>
+#include <phase4/engine/common/square.h>
+#include <phase4/engine/fen/fen_to_position.h>
+
+#include "packed_position.h"
+
+#include <algorithm>
+#include <cctype>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace phase4::engine::board {
+
+// Lines of position files, either plain FEN or EPD with operations separated by semicolons
+//   <fen> ;walls d4 ;D1 20
+// FENs without move counters are completed so EPD files load as well
+class Epd {
+public:
+	struct Line {
+		std::string fen;
+		std::vector<std::pair<std::string, std::string>> operations; // Opcode and operand
+
+		const std::string *operation(std::string_view opcode) const {
+			for (const auto &operation : operations) {
+				if (operation.first == opcode) {
+					return &operation.second;
+				}
+			}
+			return nullptr;
+		}
+	};
+
+	// Nothing for blank lines and # comments
+	static std::optional<Line> parseLine(std::string_view text) {
+		text = trim(text);
+		if (text.empty() || text[0] == '#') {
+			return {};
+		}
+
+		Line line;
+		const size_t separator = std::min(text.find(';'), text.size());
+
+		// The first six fields are the FEN, EPD only has four and starts its operations after them
+		std::vector<std::string_view> fields = split(text.substr(0, separator));
+		const bool hasCounters = fields.size() >= 6 && isNumber(fields[4]) && isNumber(fields[5]);
+		const size_t fenFields = std::min<size_t>(fields.size(), hasCounters ? 6 : 4);
+		for (size_t i = 0; i < fenFields; ++i) {
+			line.fen.append(fields[i]).append(" ");
+		}
+		line.fen.append(hasCounters || fields.size() < 4 ? "" : "0 1 ");
+		if (!line.fen.empty()) {
+			line.fen.pop_back();
+		}
+		if (fenFields < fields.size()) {
+			addOperation(line, text.substr(fields[fenFields].data() - text.data(), separator - (fields[fenFields].data() - text.data())));
+		}
+
+		size_t begin = separator + 1;
+		while (begin < text.size()) {
+			const size_t end = std::min(text.find(';', begin), text.size());
+			addOperation(line, text.substr(begin, end - begin));
+			begin = end + 1;
+		}
+		return line;
+	}
+
+	// Parses the FEN and places the walls of the walls operation
+	static std::optional<Position> toPosition(const Line &line) {
+		std::optional<Position> position = fen::FenToPosition::parse(line.fen);
+		const std::string *walls = line.operation("walls");
+		if (!position || !walls) {
+			return position;
+		}
+
+		const std::optional<common::Square> wall = PackedPosition::parseSquare(*walls);
+		if (!wall || !PackedPosition::placeWalls(*position, *wall)) {
+			return {};
+		}
+		return position;
+	}
+
+	static std::string_view trim(std::string_view text) {
+		while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front()))) {
+			text.remove_prefix(1);
+		}
+		while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) {
+			text.remove_suffix(1);
+		}
+		return text;
+	}
+
+private:
+	static std::vector<std::string_view> split(std::string_view text) {
+		std::vector<std::string_view> fields;
+		size_t begin = 0;
+		while (begin < text.size()) {
+			while (begin < text.size() && std::isspace(static_cast<unsigned char>(text[begin]))) {
+				++begin;
+			}
+			size_t end = begin;
+			while (end < text.size() && !std::isspace(static_cast<unsigned char>(text[end]))) {
+				++end;
+			}
+			if (end > begin) {
+				fields.push_back(text.substr(begin, end - begin));
+			}
+			begin = end;
+		}
+		return fields;
+	}
+
+	static bool isNumber(std::string_view text) {
+		for (const char c : text) {
+			if (!std::isdigit(static_cast<unsigned char>(c))) {
+				return false;
+			}
+		}
+		return !text.empty();
+	}
+
+	static void addOperation(Line &line, std::string_view text) {
+		text = trim(text);
+		if (text.empty()) {
+			return;
+		}
+
+		const size_t space = std::min(text.find(' '), text.size());
+		line.operations.emplace_back(std::string(text.substr(0, space)), std::string(trim(text.substr(space))));
+	}
+};
+
+} //namespace phase4::engine::board
+
+#endif
@@ -0,0 +1,206 @@
+#include "game_replicator.h"
+
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/variant/array.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <vector>
+
+using namespace godot;
+
+void GameReplicator::_bind_methods() {
+	{
+		BIND_ENUM_CONSTANT(ROLE_NONE);
+		BIND_ENUM_CONSTANT(ROLE_PUBLISHER);
+		BIND_ENUM_CONSTANT(ROLE_FOLLOWER);
+	}
+
+	{
+		const StringName publish_method = "publish";
+		ClassDB::bind_method(D_METHOD(publish_method, "game", "peer"), &GameReplicator::publish);
+	}
+
+	{
+		const StringName follow_method = "follow";
+		ClassDB::bind_method(D_METHOD(follow_method, "game", "peer"), &GameReplicator::follow);
+	}
+
+	{
+		const StringName stop_method = "stop";
+		ClassDB::bind_method(D_METHOD(stop_method), &GameReplicator::stop);
+	}
+
+	{
+		const StringName poll_method = "poll";
+		ClassDB::bind_method(D_METHOD(poll_method), &GameReplicator::poll);
+	}
+
+	{
+		const StringName get_role_method = "get_role";
+		ClassDB::bind_method(D_METHOD(get_role_method), &GameReplicator::get_role);
+	}
+
+	{
+		const StringName is_synced_method = "is_synced";
+		ClassDB::bind_method(D_METHOD(is_synced_method), &GameReplicator::is_synced);
+	}
+
+	{
+		const StringName get_bytes_sent_method = "get_bytes_sent";
+		ClassDB::bind_method(D_METHOD(get_bytes_sent_method), &GameReplicator::get_bytes_sent);
+	}
+
+	{
+		const StringName get_bytes_received_method = "get_bytes_received";
+		ClassDB::bind_method(D_METHOD(get_bytes_received_method), &GameReplicator::get_bytes_received);
+	}
+
+	{
+		const StringName get_resyncs_method = "get_resyncs";
+		ClassDB::bind_method(D_METHOD(get_resyncs_method), &GameReplicator::get_resyncs);
+	}
+}
+
+GameReplicator::~GameReplicator() {
+	stop();
+}
+
+void GameReplicator::start(Role new_role, const Ref<ChessGame> &new_game, const Ref<StreamPeer> &new_peer) {
+	stop();
+
+	ERR_FAIL_COND(new_game.is_null());
+	ERR_FAIL_COND(new_peer.is_null());
+
+	role = new_role;
+	game = new_game;
+	peer = new_peer;
+	encoder = phase4::engine::board::ReplicationEncoder();
+	decoder = phase4::engine::board::ReplicationDecoder();
+	bytes_sent = 0;
+	bytes_received = 0;
+	resyncs = 0;
+}
+
+// Sends every change made to the game from now on, followers get the whole game when they ask for it
+void GameReplicator::publish(const Ref<ChessGame> &new_game, const Ref<StreamPeer> &new_peer) {
+	start(ROLE_PUBLISHER, new_game, new_peer);
+	ERR_FAIL_COND(game.is_null() || peer.is_null());
+
+	game->set_record_sink(&encoder);
+	synced = true;
+}
+
+// Replaces the game with the published one, then applies its changes as they arrive
+void GameReplicator::follow(const Ref<ChessGame> &new_game, const Ref<StreamPeer> &new_peer) {
+	start(ROLE_FOLLOWER, new_game, new_peer);
+	ERR_FAIL_COND(game.is_null() || peer.is_null());
+
+	synced = false;
+	encoder.writeResync();
+}
+
+void GameReplicator::stop() {
+	if (role == ROLE_PUBLISHER && game.is_valid()) {
+		game->set_record_sink(nullptr);
+	}
+
+	role = ROLE_NONE;
+	game.unref();
+	peer.unref();
+	synced = false;
+}
+
+// Sends what is waiting and applies what arrived, call it every frame or after changing the game
+Error GameReplicator::poll() {
+	using namespace phase4::engine::board;
+
+	ERR_FAIL_COND_V_MSG(role == ROLE_NONE, ERR_UNCONFIGURED, "Neither publishing nor following a game.");
+
+	const int32_t available = peer->get_available_bytes();
+	if (available > 0) {
+		const Array &received = peer->get_partial_data(available);
+		const Error error = static_cast<Error>(int64_t(received[0]));
+		ERR_FAIL_COND_V(error != OK, error);
+
+		const PackedByteArray &bytes = received[1];
+		decoder.feed(bytes.ptr(), bytes.size());
+		bytes_received += bytes.size();
+
+		for (std::optional<Replication::Frame> frame = decoder.next(); frame; frame = decoder.next()) {
+			apply(*frame);
+		}
+		ERR_FAIL_COND_V_MSG(decoder.failed(), ERR_INVALID_DATA, "Invalid replication stream");
+	}
+
+	send();
+	return OK;
+}
+
+void GameReplicator::apply(const phase4::engine::board::Replication::Frame &frame) {
+	using namespace phase4::engine::board;
+
+	if (role == ROLE_PUBLISHER) {
+		if (frame.type == Replication::RESYNC) {
+			encoder.writeSnapshot(game->get_position());
+		}
+		return;
+	}
+
+	if (frame.type == Replication::SNAPSHOT) {
+		synced = game->restore_snapshot(frame.snapshot.data(), frame.snapshot.size());
+		if (!synced) {
+			encoder.writeResync();
+		}
+		return;
+	}
+
+	// Changes sent before the requested snapshot arrives are skipped
+	if (!synced || frame.type == Replication::RESYNC) {
+		return;
+	}
+
+	if (!game->apply_record(frame.record) || Replication::checksum(game->hash()) != frame.checksum) {
+		synced = false;
+		++resyncs;
+		encoder.writeResync();
+	}
+}
+
+void GameReplicator::send() {
+	std::vector<uint8_t> &output = encoder.output();
+	if (output.empty()) {
+		return;
+	}
+
+	PackedByteArray bytes;
+	bytes.resize(output.size());
+	std::memcpy(bytes.ptrw(), output.data(), output.size());
+
+	const Array &result = peer->put_partial_data(bytes);
+	const int64_t sent = static_cast<Error>(int64_t(result[0])) == OK ? int64_t(result[1]) : 0;
+	output.erase(output.begin(), output.begin() + std::clamp<int64_t>(sent, 0, output.size()));
+	bytes_sent += sent;
+}
+
+GameReplicator::Role GameReplicator::get_role() const {
+	return role;
+}
+
+bool GameReplicator::is_synced() const {
+	return synced;
+}
+
+int64_t GameReplicator::get_bytes_sent() const {
+	return bytes_sent;
+}
+
+int64_t GameReplicator::get_bytes_received() const {
+	return bytes_received;
+}
+
+// Times the follower drifted and asked for the whole game again
+int64_t GameReplicator::get_resyncs() const {
+	return resyncs;
+}
@@ -0,0 +1,63 @@
+#ifndef GAMEREPLICATOR_H
+#define GAMEREPLICATOR_H
+
+#include "chess_game.h"
+#include "replication.h"
+
+#include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/classes/stream_peer.hpp>
+
+namespace godot {
+
+// Keeps a ChessGame in another process in step with this one over a stream such as StreamPeerTCP
+// The publisher sends every change as it happens, the follower applies them and asks for a snapshot when it drifts
+class GameReplicator : public RefCounted {
+	GDCLASS(GameReplicator, RefCounted)
+
+public:
+	enum Role {
+		ROLE_NONE,
+		ROLE_PUBLISHER,
+		ROLE_FOLLOWER,
+	};
+
+private:
+	Role role = ROLE_NONE;
+	Ref<ChessGame> game;
+	Ref<StreamPeer> peer;
+
+	phase4::engine::board::ReplicationEncoder encoder;
+	phase4::engine::board::ReplicationDecoder decoder;
+	bool synced = false;
+
+	int64_t bytes_sent = 0;
+	int64_t bytes_received = 0;
+	int64_t resyncs = 0;
+
+	void start(Role new_role, const Ref<ChessGame> &new_game, const Ref<StreamPeer> &new_peer);
+	void apply(const phase4::engine::board::Replication::Frame &frame);
+	void send();
+
+protected:
+	static void _bind_methods();
+
+public:
+	~GameReplicator();
+
+	void publish(const Ref<ChessGame> &game, const Ref<StreamPeer> &peer);
+	void follow(const Ref<ChessGame> &game, const Ref<StreamPeer> &peer);
+	void stop();
+	Error poll();
+
+	Role get_role() const;
+	bool is_synced() const;
+	int64_t get_bytes_sent() const;
+	int64_t get_bytes_received() const;
+	int64_t get_resyncs() const;
+};
+
+} //namespace godot
+
+VARIANT_ENUM_CAST(godot::GameReplicator::Role);
+
+#endif
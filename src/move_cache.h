@@ -0,0 +1,97 @@
+#ifndef PHASE4_ENGINE_BOARD_MOVE_CACHE_H
+#define PHASE4_ENGINE_BOARD_MOVE_CACHE_H
+
+#include <phase4/engine/board/position.h>
+#include <phase4/engine/moves/move.h>
+
+#include "position_key.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace phase4::engine::board {
+
+// Valid moves of recently generated positions, shared by every board in the process
+// Slots are direct mapped by PositionKey so the cache never grows past SLOTS positions
+class MoveCache {
+public:
+	static constexpr size_t SLOTS = 4096;
+	static constexpr size_t LOCKS = 64;
+
+	static MoveCache &shared() {
+		static MoveCache cache;
+		return cache;
+	}
+
+	// Copies the cached moves of the position, returns false when it has not been generated yet
+	bool find(const Position &position, moves::Moves &moves) {
+		const uint64_t key = PositionKey::of(position);
+		const size_t slot = key & (SLOTS - 1);
+
+		{
+			std::lock_guard<std::mutex> lock(m_locks[slot % LOCKS]);
+			const Entry &entry = m_entries[slot];
+			if (entry.used && entry.key == key) {
+				for (size_t i = 0; i < entry.moves.size(); ++i) {
+					moves.push_back(entry.moves[i]);
+				}
+				m_hits.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		m_misses.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	void store(const Position &position, const moves::Moves &moves) {
+		const uint64_t key = PositionKey::of(position);
+		const size_t slot = key & (SLOTS - 1);
+
+		std::lock_guard<std::mutex> lock(m_locks[slot % LOCKS]);
+		Entry &entry = m_entries[slot];
+		entry.used = true;
+		entry.key = key;
+		entry.moves.clear();
+		entry.moves.reserve(moves.size());
+		for (size_t i = 0; i < moves.size(); ++i) {
+			entry.moves.push_back(moves[i]);
+		}
+	}
+
+	void clear() {
+		for (size_t slot = 0; slot < SLOTS; ++slot) {
+			std::lock_guard<std::mutex> lock(m_locks[slot % LOCKS]);
+			m_entries[slot] = Entry();
+		}
+		m_hits = 0;
+		m_misses = 0;
+	}
+
+	uint64_t hits() const {
+		return m_hits.load(std::memory_order_relaxed);
+	}
+
+	uint64_t misses() const {
+		return m_misses.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct Entry {
+		bool used = false;
+		uint64_t key = 0;
+		std::vector<moves::Move> moves;
+	};
+
+	std::array<Entry, SLOTS> m_entries;
+	std::array<std::mutex, LOCKS> m_locks;
+	std::atomic<uint64_t> m_hits = 0;
+	std::atomic<uint64_t> m_misses = 0;
+};
+
+} //namespace phase4::engine::board
+
+#endif
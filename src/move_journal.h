@@ -0,0 +1,290 @@
+#ifndef PHASE4_ENGINE_BOARD_MOVE_JOURNAL_H
+#define PHASE4_ENGINE_BOARD_MOVE_JOURNAL_H
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace phase4::engine::board {
+
+// Append only log of the changes made to a game, recovered by replaying it on top of its base snapshot
+// Every record is written through to the system right away, syncing to disk is batched on a background thread
+// A new base is written next to the journal and only renamed over it once synced, a crash keeps the previous journal
+//
+// Layout: Header, base snapshot, then 8 byte records each with a checksum that includes its position
+// Recovery stops at the first record that is incomplete or does not match its checksum
+class MoveJournal {
+public:
+	static constexpr uint32_t MAGIC = 0x4A4D3450; // P4MJ
+	static constexpr uint32_t VERSION = 1;
+	static constexpr size_t SYNC_INTERVAL = 16; // Records written between syncs
+
+	enum Type : uint8_t {
+		MOVE = 1, // From, to and flags
+		WALLS, // Square
+		SLIDE, // Direction x, y and whether it was added to the history
+		UNDO,
+		REDO, // Only in older journals, a redo is written as the MOVE it repeats
+		SEEK, // Ply in 24 bits
+	};
+
+	struct Record {
+		uint8_t type = 0;
+		std::array<uint8_t, 3> operands = {};
+	};
+
+	struct Contents {
+		std::vector<uint8_t> base;
+		std::vector<Record> records;
+	};
+
+	MoveJournal() = default;
+	MoveJournal(const MoveJournal &) = delete;
+	MoveJournal &operator=(const MoveJournal &) = delete;
+
+	~MoveJournal() {
+		close();
+	}
+
+	bool isOpen() const {
+		return m_file != nullptr;
+	}
+
+	// Replaces the journal at the path with one that starts from the base snapshot
+	// Records can be appended right away, the first sync of the background thread moves the journal into place
+	bool begin(const std::string &path, const uint8_t *base, size_t size) {
+		// The journal being replaced is left as it is, syncing it would only delay the new one
+		finish(false);
+
+		const std::string temporary = path + ".tmp";
+		m_file = std::fopen(temporary.c_str(), "wb");
+		if (!m_file) {
+			return false;
+		}
+
+		Header header;
+		header.baseSize = static_cast<uint32_t>(size);
+		header.baseChecksum = checksum(base, size, 0);
+		if (std::fwrite(&header, sizeof(header), 1, m_file) != 1 || (size > 0 && std::fwrite(base, size, 1, m_file) != 1) || std::fflush(m_file) != 0) {
+			std::fclose(m_file);
+			m_file = nullptr;
+			std::remove(temporary.c_str());
+			return false;
+		}
+
+		m_path = path;
+		m_sequence = 0;
+		m_unsynced = 0;
+		m_installed = false;
+
+#ifdef _WIN32
+		// Files opened through the C runtime can not be renamed while open, move it into place before appending
+		syncFile(m_file);
+		std::fclose(m_file);
+		m_file = install() ? std::fopen(path.c_str(), "ab") : nullptr;
+		if (!m_file) {
+			return false;
+		}
+#endif
+
+		m_stop = false;
+		m_pending = !m_installed;
+		m_syncThread = std::thread([this]() {
+			syncLoop();
+		});
+		return true;
+	}
+
+	// Starts again from a new base at the same path, used when the game is replaced
+	bool rebase(const uint8_t *base, size_t size) {
+		const std::string path = m_path;
+		return begin(path, base, size);
+	}
+
+	void append(Type type, uint8_t first = 0, uint8_t second = 0, uint8_t third = 0) {
+		if (!m_file) {
+			return;
+		}
+
+		Record record;
+		record.type = type;
+		record.operands = { first, second, third };
+
+		uint8_t bytes[RECORD_SIZE];
+		std::memcpy(bytes, &record, sizeof(record));
+		const uint32_t sum = checksum(bytes, sizeof(record), ++m_sequence);
+		std::memcpy(bytes + sizeof(record), &sum, sizeof(sum));
+
+		std::fwrite(bytes, sizeof(bytes), 1, m_file);
+		std::fflush(m_file);
+
+		if (++m_unsynced >= SYNC_INTERVAL) {
+			sync();
+		}
+	}
+
+	// Asks the background thread to sync what has been written so far
+	void sync() {
+		m_unsynced = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_pending = true;
+		}
+		m_wake.notify_one();
+	}
+
+	void close() {
+		finish(true);
+	}
+
+	// Everything that was fully written, nothing when the file is not a journal
+	static std::optional<Contents> read(const std::string &path) {
+		std::FILE *file = std::fopen(path.c_str(), "rb");
+		if (!file) {
+			return {};
+		}
+
+		Contents contents;
+		Header header;
+		bool valid = std::fread(&header, sizeof(header), 1, file) == 1 && header.magic == MAGIC && header.version == VERSION;
+		if (valid) {
+			contents.base.resize(header.baseSize);
+			valid = (header.baseSize == 0 || std::fread(contents.base.data(), header.baseSize, 1, file) == 1) &&
+					checksum(contents.base.data(), contents.base.size(), 0) == header.baseChecksum;
+		}
+
+		uint8_t bytes[RECORD_SIZE];
+		for (uint32_t sequence = 1; valid && std::fread(bytes, sizeof(bytes), 1, file) == 1; ++sequence) {
+			uint32_t sum;
+			std::memcpy(&sum, bytes + sizeof(Record), sizeof(sum));
+			if (sum != checksum(bytes, sizeof(Record), sequence)) {
+				break;
+			}
+
+			Record record;
+			std::memcpy(&record, bytes, sizeof(record));
+			contents.records.push_back(record);
+		}
+
+		std::fclose(file);
+		if (!valid) {
+			return {};
+		}
+		return contents;
+	}
+
+	// FNV-1a seeded with the record's position so records copied from elsewhere in the file do not match
+	static uint32_t checksum(const uint8_t *data, size_t size, uint32_t sequence) {
+		uint32_t hash = 2166136261u ^ sequence;
+		for (size_t i = 0; i < size; ++i) {
+			hash = (hash ^ data[i]) * 16777619u;
+		}
+		return hash;
+	}
+
+private:
+	struct Header {
+		uint32_t magic = MAGIC;
+		uint32_t version = VERSION;
+		uint32_t baseSize = 0;
+		uint32_t baseChecksum = 0;
+	};
+
+	static constexpr size_t RECORD_SIZE = sizeof(Record) + sizeof(uint32_t);
+
+	static_assert(sizeof(Record) == 4, "Records are written as bytes");
+
+	static void syncFile(std::FILE *file) {
+#ifdef _WIN32
+		_commit(_fileno(file));
+#else
+		fsync(fileno(file));
+#endif
+	}
+
+	// Replaces the journal at the path with the synced one written next to it, false when it could not be moved
+	bool install() {
+		const std::string temporary = m_path + ".tmp";
+#ifdef _WIN32
+		std::remove(m_path.c_str()); // Renaming does not replace an existing file
+#endif
+		m_installed = std::rename(temporary.c_str(), m_path.c_str()) == 0;
+		return m_installed;
+	}
+
+	// Stops the sync thread and closes the file
+	// A journal that is kept is synced and moved into place, one about to be replaced is dropped with what is pending
+	void finish(bool keep) {
+		if (!m_file) {
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+			m_pending = m_pending && keep;
+		}
+		m_wake.notify_one();
+		m_syncThread.join();
+
+		if (keep) {
+			syncFile(m_file);
+			if (!m_installed) {
+				install();
+			}
+		}
+		std::fclose(m_file);
+		m_file = nullptr;
+	}
+
+	// Pending syncs are done before stopping, the first one also moves a new journal into place
+	void syncLoop() {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true) {
+			m_wake.wait(lock, [this]() {
+				return m_pending || m_stop;
+			});
+
+			if (!m_pending) {
+				return;
+			}
+
+			m_pending = false;
+			lock.unlock();
+			syncFile(m_file);
+			if (!m_installed) {
+				install();
+			}
+			lock.lock();
+		}
+	}
+
+	std::FILE *m_file = nullptr;
+	std::string m_path;
+	uint32_t m_sequence = 0;
+	size_t m_unsynced = 0;
+	bool m_installed = false; // The file is at m_path rather than next to it
+
+	std::thread m_syncThread;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	bool m_pending = false;
+	bool m_stop = false;
+};
+
+} //namespace phase4::engine::board
+
+#endif
@@ -0,0 +1,215 @@
+#ifndef PHASE4_ENGINE_BOARD_PACKED_POSITION_H
+#define PHASE4_ENGINE_BOARD_PACKED_POSITION_H
+
+#include <phase4/engine/board/position.h>
+#include <phase4/engine/board/zobrist_hashing.h>
+#include <phase4/engine/common/castling.h>
+#include <phase4/engine/common/piece_color.h>
+#include <phase4/engine/common/piece_type.h>
+#include <phase4/engine/common/square.h>
+#include <phase4/engine/common/wall_operations.h>
+
+#include "attack_maps.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+namespace phase4::engine::board {
+
+// Fixed size binary form of a position, with what a FEN holds and the walls
+// Pieces are listed in square order as color << 3 | type, two to a byte with the low nibble first
+// Records are written in the byte order of the machine, every supported platform is little endian
+struct PackedPosition {
+	static constexpr size_t MAX_PIECES = 32;
+	static constexpr uint8_t NO_SQUARE = 0xFF;
+
+	// Bits of flags
+	static constexpr uint8_t BLACK_TO_MOVE = 1 << 0;
+	static constexpr uint8_t WHITE_KING_SIDE = 1 << 1;
+	static constexpr uint8_t WHITE_QUEEN_SIDE = 1 << 2;
+	static constexpr uint8_t BLACK_KING_SIDE = 1 << 3;
+	static constexpr uint8_t BLACK_QUEEN_SIDE = 1 << 4;
+
+	uint64_t occupancy = 0; // Squares holding a piece, walls only where they were placed on one
+	std::array<uint8_t, MAX_PIECES / 2> pieces = {};
+	uint8_t wall = NO_SQUARE; // Square the walls were placed with
+	uint8_t flags = 0;
+	uint8_t enPassant = NO_SQUARE;
+	uint8_t halfmoveClock = 0;
+	uint16_t fullmoveNumber = 1;
+	std::array<uint8_t, 2> reserved = {}; // Always zero so records compare and hash as bytes
+
+	// Square of a name such as e4, nothing when it does not name a square
+	static std::optional<common::Square> parseSquare(std::string_view name) {
+		if (name.size() != 2 || name[0] < 'a' || name[0] > 'h' || name[1] < '1' || name[1] > '8') {
+			return {};
+		}
+
+		const char buffer[] = { name[0], name[1], '\0' };
+		return common::Square(buffer);
+	}
+
+	// Places a wall block at the requested square, fails if walls were already placed
+	static bool placeWalls(Position &position, common::Square square) {
+		using namespace common;
+
+		if (position.walls() > 0) {
+			return false; // This might not be safe if pieces get removed
+			// TODO: Allow this to happen
+			// Remove old walls
+			position.occupancySummary() &= ~position.walls();
+			position.hash() = position.hash().toggleWalls(position.walls());
+		}
+
+		position.walls() = WallOperations::SLIDE_FROM[square];
+		position.occupancySummary() |= position.walls();
+		position.hash() = position.hash().toggleWalls(position.walls());
+		return true;
+	}
+
+	// Nothing when the position does not fit, such as more than MAX_PIECES pieces
+	static std::optional<PackedPosition> pack(const Position &position) {
+		using namespace common;
+
+		PackedPosition packed;
+		const uint64_t walls = position.walls().get_raw_value();
+
+		size_t count = 0;
+		for (uint64_t squares = position.occupancySummary().get_raw_value(); squares != 0; squares &= squares - 1) {
+			const size_t square = AttackMaps::lowest(squares);
+			const std::optional<std::tuple<PieceColor, PieceType>> piece = position.getPiece(Square(square));
+			if (!piece && (walls & (uint64_t(1) << square)) != 0) {
+				continue;
+			}
+			if (!piece || count == MAX_PIECES) {
+				return {};
+			}
+
+			const uint8_t code = static_cast<uint8_t>(std::get<0>(*piece).get_raw_value() << 3 | std::get<1>(*piece).get_raw_value());
+			packed.pieces[count / 2] |= count % 2 == 0 ? code : code << 4;
+			packed.occupancy |= uint64_t(1) << square;
+			++count;
+		}
+
+		if (walls != 0) {
+			packed.wall = static_cast<uint8_t>(AttackMaps::lowest(walls));
+			if (WallOperations::SLIDE_FROM[packed.wall].get_raw_value() != walls) {
+				return {};
+			}
+		}
+
+		const Castling castling = position.castling();
+		packed.flags = position.colorToMove() == PieceColor::BLACK ? BLACK_TO_MOVE : 0;
+		packed.flags |= (castling & Castling::WHITE_SHORT) != Castling::NONE ? WHITE_KING_SIDE : 0;
+		packed.flags |= (castling & Castling::WHITE_LONG) != Castling::NONE ? WHITE_QUEEN_SIDE : 0;
+		packed.flags |= (castling & Castling::BLACK_SHORT) != Castling::NONE ? BLACK_KING_SIDE : 0;
+		packed.flags |= (castling & Castling::BLACK_LONG) != Castling::NONE ? BLACK_QUEEN_SIDE : 0;
+		if (position.enPassant() != 0) {
+			packed.enPassant = Square(position.enPassant()).get_raw_value();
+		}
+		packed.halfmoveClock = static_cast<uint8_t>(std::min<uint64_t>(position.irreversibleMovesCount(), 255));
+		packed.fullmoveNumber = static_cast<uint16_t>(std::clamp<uint64_t>(position.movesCount(), 1, UINT16_MAX));
+		return packed;
+	}
+
+	// FEN of the record, the walls are not part of it
+	std::string fen() const {
+		using namespace common;
+
+		std::string text;
+		for (int16_t y = 7; y >= 0; --y) {
+			size_t empty = 0;
+			for (int16_t x = 0; x < 8; ++x) {
+				const size_t square = Square(FieldIndex(x, y)).get_raw_value();
+				if ((occupancy & (uint64_t(1) << square)) == 0) {
+					++empty;
+					continue;
+				}
+
+				if (empty != 0) {
+					text += static_cast<char>('0' + empty);
+					empty = 0;
+				}
+				const uint8_t code = piece(occupancy & ((uint64_t(1) << square) - 1));
+				const char letter = "pnbrqk??"[code & 7];
+				text += (code >> 3) == PieceColor::WHITE.get_raw_value() ? static_cast<char>(letter - 'a' + 'A') : letter;
+			}
+			if (empty != 0) {
+				text += static_cast<char>('0' + empty);
+			}
+			text += y > 0 ? "/" : "";
+		}
+
+		text += (flags & BLACK_TO_MOVE) != 0 ? " b " : " w ";
+		const size_t rights = text.size();
+		text += (flags & WHITE_KING_SIDE) != 0 ? "K" : "";
+		text += (flags & WHITE_QUEEN_SIDE) != 0 ? "Q" : "";
+		text += (flags & BLACK_KING_SIDE) != 0 ? "k" : "";
+		text += (flags & BLACK_QUEEN_SIDE) != 0 ? "q" : "";
+		text += text.size() == rights ? "-" : "";
+		text += " ";
+		text += enPassant < 64 ? Square(static_cast<size_t>(enPassant)).asBuffer().data() : "-";
+		text += " " + std::to_string(halfmoveClock) + " " + std::to_string(fullmoveNumber);
+		return text;
+	}
+
+	// Decoded straight into the position the way the engine builds one, nothing when the record does not hold a valid position
+	std::optional<Position> unpack() const {
+		using namespace common;
+
+		if ((wall != NO_SQUARE && wall >= 64) || (enPassant != NO_SQUARE && enPassant >= 64) || reserved[0] != 0 || reserved[1] != 0) {
+			return {};
+		}
+
+		Position position;
+		size_t index = 0;
+		for (uint64_t squares = occupancy; squares != 0; squares &= squares - 1, ++index) {
+			const uint8_t code = index < MAX_PIECES ? (pieces[index / 2] >> (index % 2 * 4)) & 0xF : 0xF;
+			if ((code & 7) > 5) {
+				return {};
+			}
+			position.addPiece(PieceColor(static_cast<uint8_t>(code >> 3)), PieceType(static_cast<uint8_t>(code & 7)), Square(AttackMaps::lowest(squares)));
+		}
+
+		Castling castling = Castling::NONE;
+		castling = (flags & WHITE_KING_SIDE) != 0 ? castling | Castling::WHITE_SHORT : castling;
+		castling = (flags & WHITE_QUEEN_SIDE) != 0 ? castling | Castling::WHITE_LONG : castling;
+		castling = (flags & BLACK_KING_SIDE) != 0 ? castling | Castling::BLACK_SHORT : castling;
+		castling = (flags & BLACK_QUEEN_SIDE) != 0 ? castling | Castling::BLACK_LONG : castling;
+		position.colorToMove() = (flags & BLACK_TO_MOVE) != 0 ? PieceColor::BLACK : PieceColor::WHITE;
+		position.castling() = castling;
+		if (enPassant != NO_SQUARE) {
+			position.enPassant() = Square(static_cast<size_t>(enPassant)).asBitboard();
+		}
+		position.irreversibleMovesCount() = halfmoveClock;
+		position.movesCount() = fullmoveNumber;
+		position.hash() = ZobristHashing::calculateHash(position);
+
+		if (wall != NO_SQUARE && !placeWalls(position, Square(static_cast<size_t>(wall)))) {
+			return {};
+		}
+		return position;
+	}
+
+private:
+	// Code of the piece on the square above the given squares, which are the occupied squares below it
+	uint8_t piece(uint64_t below) const {
+		size_t index = 0;
+		for (; below != 0; below &= below - 1) {
+			++index;
+		}
+		return index < MAX_PIECES ? (pieces[index / 2] >> (index % 2 * 4)) & 0xF : 0xF;
+	}
+};
+
+static_assert(sizeof(PackedPosition) == 32 && std::is_trivially_copyable_v<PackedPosition>, "Packed positions are copied as bytes");
+
+} //namespace phase4::engine::board
+
+#endif
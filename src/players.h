@@ -0,0 +1,106 @@
+#ifndef PHASE4_ENGINE_BOARD_PLAYERS_H
+#define PHASE4_ENGINE_BOARD_PLAYERS_H
+
+#include "position_view.h"
+
+#include <phase4/engine/board/position.h>
+#include <phase4/engine/common/piece_color.h>
+#include <phase4/engine/common/piece_type.h>
+#include <phase4/engine/common/square.h>
+#include <phase4/engine/moves/move.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+namespace phase4::engine::board {
+
+// Small seeded generator so games can be replayed from their seed on any platform
+class Random {
+public:
+	explicit Random(uint64_t seed) :
+			m_state(seed) {
+	}
+
+	// SplitMix64
+	uint64_t next() {
+		uint64_t value = (m_state += 0x9E3779B97F4A7C15ull);
+		value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+		value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+		return value ^ (value >> 31);
+	}
+
+	// Uniform enough below the 64 bit range for picking moves and squares
+	size_t below(size_t count) {
+		return static_cast<size_t>(next() % count);
+	}
+
+private:
+	uint64_t m_state;
+};
+
+// Something that picks moves in self play, each game owns its players so they may keep state between moves
+class Player {
+public:
+	virtual ~Player() = default;
+
+	// One of the valid moves of the viewed position, nothing when there are none
+	virtual std::optional<moves::Move> choose(const PositionView &position, Random &random) = 0;
+};
+
+class RandomPlayer : public Player {
+public:
+	std::optional<moves::Move> choose(const PositionView &position, Random &random) override {
+		const moves::Moves &moves = position.validMoves();
+		if (moves.size() == 0) {
+			return {};
+		}
+		return moves[random.below(moves.size())];
+	}
+};
+
+// Takes the most valuable piece it can, any move when nothing can be taken
+class GreedyCapturePlayer : public Player {
+public:
+	std::optional<moves::Move> choose(const PositionView &position, Random &random) override {
+		using namespace common;
+
+		static constexpr std::array<int32_t, 6> VALUES = { 1, 3, 3, 5, 9, 0 }; // By piece type
+
+		const moves::Moves &moves = position.validMoves();
+		if (moves.size() == 0) {
+			return {};
+		}
+
+		const Position &current = position.current();
+		const PieceColor enemy = current.colorToMove().invert();
+
+		int32_t bestValue = -1;
+		size_t bestCount = 0;
+		size_t best = 0;
+		for (size_t i = 0; i < moves.size(); ++i) {
+			int32_t value = 0;
+			for (PieceType type = PieceType::PAWN; type != PieceType::INVALID; ++type) {
+				if ((current.colorPieceMask(enemy, type) & moves[i].to().asBitboard()) != 0) {
+					value = VALUES[type.get_raw_value()];
+					break;
+				}
+			}
+
+			// Reservoir sampling keeps ties fair without collecting them
+			if (value > bestValue) {
+				bestValue = value;
+				bestCount = 1;
+				best = i;
+			} else if (value == bestValue && random.below(++bestCount) == 0) {
+				best = i;
+			}
+		}
+		return moves[best];
+	}
+};
+
+} //namespace phase4::engine::board
+
+#endif
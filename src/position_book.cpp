@@ -0,0 +1,104 @@
+#include "position_book.h"
+
+#include "chess2d.h"
+
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/project_settings.hpp>
+#include <godot_cpp/core/class_db.hpp>
+
+#include <phase4/engine/fen/fen_to_position.h>
+
+#include <optional>
+
+using namespace godot;
+
+void PositionBook::_bind_methods() {
+	{
+		const StringName open_method = "open";
+		ClassDB::bind_method(D_METHOD(open_method, "path"), &PositionBook::open);
+	}
+
+	{
+		const StringName close_method = "close";
+		ClassDB::bind_method(D_METHOD(close_method), &PositionBook::close);
+	}
+
+	{
+		const StringName get_count_method = "get_count";
+		ClassDB::bind_method(D_METHOD(get_count_method), &PositionBook::get_count);
+	}
+
+	{
+		const StringName lookup_method = "lookup";
+		ClassDB::bind_method(D_METHOD(lookup_method, "board"), &PositionBook::lookup);
+	}
+
+	{
+		const StringName lookup_fen_method = "lookup_fen";
+		ClassDB::bind_method(D_METHOD(lookup_fen_method, "fen"), &PositionBook::lookup_fen);
+	}
+}
+
+Error PositionBook::open(const String &path) {
+	close();
+
+	const String global_path = ProjectSettings::get_singleton()->globalize_path(path);
+	if (book.open(global_path.utf8().get_data())) {
+		return OK;
+	}
+
+	bytes = FileAccess::get_file_as_bytes(path);
+	const Error error = FileAccess::get_open_error();
+	ERR_FAIL_COND_V_MSG(error != OK, error, "Could not open " + path);
+	if (!book.attach(bytes.ptr(), bytes.size())) {
+		bytes.clear();
+		ERR_FAIL_V_MSG(ERR_FILE_CORRUPT, "Invalid position book: " + path);
+	}
+	return OK;
+}
+
+void PositionBook::close() {
+	book.close();
+	bytes.clear();
+}
+
+int64_t PositionBook::get_count() const {
+	return book.size();
+}
+
+// Data of the position the board is viewing, empty when the book does not know it
+Dictionary PositionBook::lookup(const Chess2D *board) const {
+	ERR_FAIL_NULL_V(board, Dictionary());
+	return lookup_hash(board->get_current_position().hash().get_raw_value());
+}
+
+Dictionary PositionBook::lookup_fen(const String &fen) const {
+	using namespace phase4::engine::board;
+	using namespace phase4::engine::fen;
+
+	const std::optional<Position> &position = FenToPosition::parse(fen.ascii().get_data());
+	ERR_FAIL_COND_V_MSG(!position, Dictionary(), "Invalid fen: " + fen);
+	return lookup_hash(position->hash().get_raw_value());
+}
+
+Dictionary PositionBook::lookup_hash(uint64_t hash) const {
+	using namespace phase4::engine::board;
+
+	Dictionary result;
+	const Book::Entry *entry = book.find(hash);
+	if (!entry) {
+		return result;
+	}
+
+	PackedStringArray moves;
+	for (const uint16_t move : entry->moves) {
+		if (move != Book::NO_MOVE) {
+			moves.push_back(String(Book::moveNotation(move).c_str()));
+		}
+	}
+
+	result["frequency"] = static_cast<int64_t>(entry->frequency);
+	result["score"] = static_cast<int64_t>(entry->score);
+	result["moves"] = moves;
+	return result;
+}
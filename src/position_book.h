@@ -0,0 +1,39 @@
+#ifndef POSITIONBOOK_H
+#define POSITIONBOOK_H
+
+#include "book.h"
+
+#include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+
+namespace godot {
+
+class Chess2D;
+
+// Opening and known position data looked up by position hash
+// Books are mapped instead of read so opening one takes the same time at any size
+class PositionBook : public RefCounted {
+	GDCLASS(PositionBook, RefCounted)
+
+private:
+	phase4::engine::board::Book book;
+	PackedByteArray bytes; // Books inside packs can not be mapped and are read instead
+
+	Dictionary lookup_hash(uint64_t hash) const;
+
+protected:
+	static void _bind_methods();
+
+public:
+	Error open(const String &path);
+	void close();
+
+	int64_t get_count() const;
+
+	Dictionary lookup(const Chess2D *board) const;
+	Dictionary lookup_fen(const String &fen) const;
+};
+
+} //namespace godot
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef PHASE4_ENGINE_BOARD_POSITION_KEY_H
+#define PHASE4_ENGINE_BOARD_POSITION_KEY_H
+
+#include <phase4/engine/board/position.h>
+
+#include <cstdint>
+
+namespace phase4::engine::board {
+
+// Key that tables and repetition checks identify positions by, so they all agree on which positions are the same
+// The occupancy guards against positions whose hash was not updated by a wall slide, perft --hashes checks the hashes
+class PositionKey {
+public:
+	static uint64_t of(const Position &position) {
+		return position.hash().get_raw_value() ^ (position.occupancySummary().get_raw_value() * 0x9E3779B97F4A7C15ULL);
+	}
+};
+
+} //namespace phase4::engine::board
+
+#endif
@@ -0,0 +1,190 @@
+#include "position_store.h"
+
+#include "epd.h"
+
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/os.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/core/property_info.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <string_view>
+
+using namespace godot;
+
+namespace {
+constexpr int64_t MIN_CHUNK_SIZE = 64 * 1024;
+} //namespace
+
+void PositionStore::_bind_methods() {
+	const StringName class_name = "PositionStore";
+
+	{
+		const StringName get_records_method = "get_records";
+		const StringName set_records_method = "set_records";
+		const StringName records_property = "records";
+		ClassDB::bind_method(D_METHOD(get_records_method), &PositionStore::get_records);
+		ClassDB::bind_method(D_METHOD(set_records_method, records_property), &PositionStore::set_records);
+		ClassDB::add_property(class_name, PropertyInfo(Variant::PACKED_BYTE_ARRAY, records_property, PROPERTY_HINT_NONE, "", PROPERTY_USAGE_STORAGE), set_records_method, get_records_method);
+	}
+
+	{
+		const StringName load_file_method = "load_file";
+		ClassDB::bind_method(D_METHOD(load_file_method, "path"), &PositionStore::load_file);
+	}
+
+	{
+		const StringName clear_method = "clear";
+		ClassDB::bind_method(D_METHOD(clear_method), &PositionStore::clear);
+	}
+
+	{
+		const StringName get_count_method = "get_count";
+		ClassDB::bind_method(D_METHOD(get_count_method), &PositionStore::get_count);
+	}
+
+	{
+		const StringName get_invalid_lines_method = "get_invalid_lines";
+		ClassDB::bind_method(D_METHOD(get_invalid_lines_method), &PositionStore::get_invalid_lines);
+	}
+
+	{
+		const StringName get_fen_method = "get_fen";
+		ClassDB::bind_method(D_METHOD(get_fen_method, "index"), &PositionStore::get_fen);
+	}
+}
+
+// Replaces the stored positions with the valid lines of the file, returns the error opening it
+// The file is split into chunks of whole lines that are parsed in parallel and joined in order
+Error PositionStore::load_file(const String &path) {
+	clear();
+
+	ingest_bytes = FileAccess::get_file_as_bytes(path);
+	const Error error = FileAccess::get_open_error();
+	ERR_FAIL_COND_V_MSG(error != OK, error, "Could not open " + path);
+
+	const int64_t size = ingest_bytes.size();
+	const uint8_t *data = ingest_bytes.ptr();
+	const int64_t tasks = std::max<int64_t>(OS::get_singleton()->get_processor_count(), 1) * 4;
+	const int64_t chunk_size = std::max(MIN_CHUNK_SIZE, size / tasks + 1);
+
+	for (int64_t begin = 0; begin < size;) {
+		int64_t end = std::min(begin + chunk_size, size);
+		while (end < size && data[end - 1] != '\n') {
+			++end;
+		}
+
+		Chunk chunk;
+		chunk.begin = begin;
+		chunk.end = end;
+		ingest_chunks.push_back(std::move(chunk));
+		begin = end;
+	}
+
+	if (ingest_chunks.empty()) {
+		ingest_bytes.clear();
+		emit_changed();
+		return OK;
+	}
+
+	WorkerThreadPool *pool = WorkerThreadPool::get_singleton();
+	const int64_t task = pool->add_group_task(callable_mp(this, &PositionStore::ingest_chunk), ingest_chunks.size(), -1, true, "PositionStore ingest");
+	pool->wait_for_group_task_completion(task);
+
+	size_t count = 0;
+	for (const Chunk &chunk : ingest_chunks) {
+		count += chunk.records.size();
+	}
+	records.resize(count * sizeof(PackedPosition));
+
+	uint8_t *record = records.ptrw();
+	int64_t first_line = 1;
+	for (const Chunk &chunk : ingest_chunks) {
+		std::memcpy(record, chunk.records.data(), chunk.records.size() * sizeof(PackedPosition));
+		record += chunk.records.size() * sizeof(PackedPosition);
+		for (const int64_t line : chunk.invalid_lines) {
+			invalid_lines.push_back(first_line + line);
+		}
+		first_line += chunk.lines;
+	}
+
+	ingest_chunks.clear();
+	ingest_bytes.clear();
+	emit_changed();
+	return OK;
+}
+
+void PositionStore::ingest_chunk(uint32_t index) {
+	using namespace phase4::engine::board;
+
+	Chunk &chunk = ingest_chunks[index];
+	const char *data = reinterpret_cast<const char *>(ingest_bytes.ptr());
+
+	for (int64_t begin = chunk.begin; begin < chunk.end; ++chunk.lines) {
+		const char *newline = static_cast<const char *>(std::memchr(data + begin, '\n', chunk.end - begin));
+		const int64_t end = newline ? newline - data : chunk.end;
+		const std::string_view text(data + begin, end - begin);
+		begin = end + 1;
+
+		const std::optional<Epd::Line> line = Epd::parseLine(text);
+		if (!line) {
+			continue;
+		}
+
+		const std::optional<Position> position = Epd::toPosition(*line);
+		const std::optional<PackedPosition> packed = position ? PackedPosition::pack(*position) : std::nullopt;
+		if (!packed) {
+			chunk.invalid_lines.push_back(chunk.lines);
+			continue;
+		}
+		chunk.records.push_back(*packed);
+	}
+}
+
+void PositionStore::clear() {
+	records.clear();
+	invalid_lines.clear();
+}
+
+// Records of another store or a saved resource, the size has to be a whole number of records
+void PositionStore::set_records(const PackedByteArray &p_records) {
+	ERR_FAIL_COND_MSG(p_records.size() % sizeof(phase4::engine::board::PackedPosition) != 0, "Invalid position records");
+	records = p_records;
+	invalid_lines.clear();
+	emit_changed();
+}
+
+PackedByteArray PositionStore::get_records() const {
+	return records;
+}
+
+int64_t PositionStore::get_count() const {
+	return records.size() / sizeof(phase4::engine::board::PackedPosition);
+}
+
+// Line numbers of the last loaded file that could not be parsed, starting at 1
+PackedInt64Array PositionStore::get_invalid_lines() const {
+	return invalid_lines;
+}
+
+String PositionStore::get_fen(int64_t index) const {
+	ERR_FAIL_INDEX_V(index, get_count(), String());
+	return String(get_record(index).fen().c_str());
+}
+
+phase4::engine::board::PackedPosition PositionStore::get_record(int64_t index) const {
+	phase4::engine::board::PackedPosition record;
+	ERR_FAIL_INDEX_V(index, get_count(), record);
+	std::memcpy(&record, records.ptr() + index * sizeof(record), sizeof(record));
+	return record;
+}
+
+std::optional<phase4::engine::board::Position> PositionStore::get_position(int64_t index) const {
+	ERR_FAIL_INDEX_V(index, get_count(), std::nullopt);
+	const std::optional<phase4::engine::board::Position> position = get_record(index).unpack();
+	ERR_FAIL_COND_V_MSG(!position, std::nullopt, "Invalid position record " + String::num_int64(index));
+	return position;
+}
@@ -0,0 +1,61 @@
+#ifndef POSITIONSTORE_H
+#define POSITIONSTORE_H
+
+#include "packed_position.h"
+
+#include <godot_cpp/classes/resource.hpp>
+#include <godot_cpp/variant/packed_byte_array.hpp>
+#include <godot_cpp/variant/packed_int64_array.hpp>
+
+#include <phase4/engine/board/position.h>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace godot {
+
+// Positions parsed once from FEN or EPD files and kept as fixed size PackedPosition records
+// The records are the stored property of the resource, so a store saved with ResourceSaver loads without the file
+class PositionStore : public Resource {
+	GDCLASS(PositionStore, Resource)
+
+private:
+	// Whole lines of the file parsed by one worker task
+	struct Chunk {
+		int64_t begin = 0;
+		int64_t end = 0;
+		int64_t lines = 0;
+		std::vector<phase4::engine::board::PackedPosition> records;
+		std::vector<int64_t> invalid_lines; // Counted from the start of the chunk
+	};
+
+	PackedByteArray records; // PackedPosition records one after the other
+	PackedInt64Array invalid_lines;
+
+	PackedByteArray ingest_bytes;
+	std::vector<Chunk> ingest_chunks;
+
+	void ingest_chunk(uint32_t index);
+
+protected:
+	static void _bind_methods();
+
+public:
+	Error load_file(const String &path);
+	void clear();
+
+	void set_records(const PackedByteArray &records);
+	PackedByteArray get_records() const;
+
+	int64_t get_count() const;
+	PackedInt64Array get_invalid_lines() const;
+	String get_fen(int64_t index) const;
+
+	phase4::engine::board::PackedPosition get_record(int64_t index) const;
+	std::optional<phase4::engine::board::Position> get_position(int64_t index) const;
+};
+
+} //namespace godot
+
+#endif
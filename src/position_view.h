@@ -5,11 +5,36 @@
 #include <phase4/engine/board/position_state.h>
 #include <phase4/engine/board/session.h>
 
+#include "attack_maps.h"
+#include "engine_log.h"
+#include "move_cache.h"
+#include "move_journal.h"
+#include "packed_position.h"
+#include "position_key.h"
+#include "variation_tree.h"
+#include "wall_slides.h"
+
 #include <phase4/engine/common/math.h>
 #include <phase4/engine/common/wall_operations.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <cwchar>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PHASE4_POSITION_VIEW_SSE2
+#endif
+#include <vector>
 
 namespace phase4::engine::board {
 
@@ -35,22 +60,46 @@ struct PieceAndSquareOffset {
 	}
 };
 
-struct AlgebraicPieceAndSquareOffset : public PieceAndSquareOffset {
-	AlgebraicNotation algebraic_notation;
+// Ids and squares are stored as bytes so the tables stay small and can be compared 16 at a time
+struct Maps {
+	static constexpr uint8_t NO_ID = 0xFF;
+	static constexpr uint8_t NO_SQUARE = common::Square::INVALID.get_raw_value();
+
+	std::array<uint8_t, 64> square_id; // Which piece id is on a square
+	std::array<uint8_t, 64> id_square; // Which square owns this piece id
 
-	AlgebraicPieceAndSquareOffset() :
-			PieceAndSquareOffset() {
-		snprintf(algebraic_notation.data(), algebraic_notation.size(), "");
+	Maps() {
+		square_id.fill(NO_ID);
+		id_square.fill(NO_SQUARE);
 	}
-};
 
-struct Maps {
-	std::array<size_t, 64> square_id; // Which piece id is on a square
-	std::array<phase4::engine::common::Square, 64> id_square; // Which square owns this piece id
+	common::Square square(uint8_t id) const {
+		return common::Square(static_cast<size_t>(id_square[id]));
+	}
 
-	Maps() {
-		square_id.fill(-1);
-		id_square.fill(phase4::engine::common::Square::INVALID);
+	// Bit per piece id that is on the board in both maps but on a different square
+	static uint64_t movedIds(const Maps &from, const Maps &to) {
+#ifdef PHASE4_POSITION_VIEW_SSE2
+		const __m128i noSquare = _mm_set1_epi8(static_cast<char>(NO_SQUARE));
+		uint64_t moved = 0;
+		for (size_t i = 0; i < 64; i += 16) {
+			const __m128i fromSquares = _mm_loadu_si128(reinterpret_cast<const __m128i *>(from.id_square.data() + i));
+			const __m128i toSquares = _mm_loadu_si128(reinterpret_cast<const __m128i *>(to.id_square.data() + i));
+			const __m128i unchanged = _mm_or_si128(
+					_mm_cmpeq_epi8(fromSquares, toSquares),
+					_mm_or_si128(_mm_cmpeq_epi8(fromSquares, noSquare), _mm_cmpeq_epi8(toSquares, noSquare)));
+			moved |= static_cast<uint64_t>(~_mm_movemask_epi8(unchanged) & 0xFFFF) << i;
+		}
+		return moved;
+#else
+		uint64_t moved = 0;
+		for (size_t id = 0; id < 64; ++id) {
+			if (from.id_square[id] != NO_SQUARE && to.id_square[id] != NO_SQUARE && from.id_square[id] != to.id_square[id]) {
+				moved |= uint64_t(1) << id;
+			}
+		}
+		return moved;
+#endif
 	}
 };
 struct Detail {
@@ -59,116 +108,231 @@ struct Detail {
 
 	Maps maps;
 
-	void update_maps(const moves::Result &result) {
+	// Returns the id of the captured piece, or NO_ID when nothing was captured
+	uint8_t update_maps(const moves::Result &result) {
 		using namespace common;
 
+		uint8_t capturedId = Maps::NO_ID;
 		for (size_t i = 0; i < result.moved.size(); ++i) {
-			const size_t fromId = maps.square_id[result.moved[i].from];
-			const size_t toId = maps.square_id[result.moved[i].to];
+			const uint8_t fromId = maps.square_id[result.moved[i].from];
+			const uint8_t toId = maps.square_id[result.moved[i].to];
 
 			// Update the square for the moved piece ID
-			maps.id_square[fromId] = result.moved[i].to;
+			maps.id_square[fromId] = result.moved[i].to.get_raw_value();
 			maps.square_id[result.moved[i].to] = fromId;
 
 			// Remove the captured piece ID
-			if (toId != -1) {
-				maps.id_square[toId] = Square::INVALID;
+			if (toId != Maps::NO_ID) {
+				maps.id_square[toId] = Maps::NO_SQUARE;
+				capturedId = toId;
 			}
 
 			// Remove the moved piece ID
-			maps.square_id[result.moved[i].from] = -1;
+			maps.square_id[result.moved[i].from] = Maps::NO_ID;
 		}
 
 		if (result.slide && result.slide != FieldIndex::ZERO) {
-			Bitboard walls = position.walls();
-			while (walls > 0) {
-				const Square wall(walls);
-				walls = walls.popLsb();
-
-				const size_t fromId = maps.square_id[wall];
-				if (fromId != -1) {
-					// Update the square for the moved piece ID
-					const Square wallOffset(wall.get_raw_value() - result.slide->offset());
-					maps.id_square[fromId] = wallOffset;
-					maps.square_id[wallOffset] = fromId;
-
-					// Remove the moved piece ID
-					maps.square_id[wall] = -1;
-				}
+			slide_maps(*result.slide);
+		}
+
+		return capturedId;
+	}
+
+	// Moves the ids of pieces the walls slid onto out of the way, the walls are already at their new squares
+	void slide_maps(common::FieldIndex slide) {
+		using namespace common;
+
+		Bitboard walls = position.walls();
+		while (walls > 0) {
+			const Square wall(walls);
+			walls = walls.popLsb();
+
+			const uint8_t fromId = maps.square_id[wall];
+			if (fromId != Maps::NO_ID) {
+				// Update the square for the moved piece ID
+				const Square wallOffset(wall.get_raw_value() - slide.offset());
+				maps.id_square[fromId] = wallOffset.get_raw_value();
+				maps.square_id[wallOffset] = fromId;
+
+				// Remove the moved piece ID
+				maps.square_id[wall] = Maps::NO_ID;
 			}
 		}
 	}
 };
 
+// Compact record of a single ply, replayed on top of the nearest keyframe
+struct Delta {
+	moves::Move move = moves::Move::EMPTY; // EMPTY when the ply only placed walls
+	common::Square wall = common::Square::INVALID; // Square passed to setWalls
+	int8_t slide_x = 0; // Wall slide caused by the move
+	int8_t slide_y = 0;
+	uint8_t captured = Maps::NO_ID; // Piece id removed by the move
+
+	common::FieldIndex slide() const {
+		return common::FieldIndex(slide_x, slide_y);
+	}
+};
+
+// Full state stored every few plies so any ply can be rebuilt with a bounded replay
+struct Keyframe {
+	size_t ply;
+	Position position;
+	Maps maps;
+};
+
+class PositionView;
+
+// Receives every change made to a game as the journal record that repeats it
+class RecordSink {
+public:
+	virtual ~RecordSink() = default;
+
+	// The hash is the one of the viewed position after the change
+	virtual void record(const MoveJournal::Record &record, uint64_t hash) = 0;
+
+	// The game was replaced as a whole, by reset or restore
+	virtual void replaced(const PositionView &view) = 0;
+};
+
 class PositionView {
 public:
+	using SquareMoves = common::FastVector<moves::Move, 27>; // A queen reaches at most 27 squares
+
+	// Plies between stored positions, bounds the replay done by seek and undo
+	static constexpr size_t KEYFRAME_INTERVAL = 16;
+
+	// Plies searched for repetitions, covers the hundred plies of the fifty move rule
+	static constexpr size_t REPETITION_PLIES = 128;
+
+	// Positions that keep their valid destinations, the least recently viewed generate them again
+	static constexpr size_t CACHED_DESTINATIONS = 64;
+
+	// Nodes the variation tree grows to before lines that were left are pruned to their first ply
+	static constexpr size_t PRUNED_TREE_NODES = 16384;
+
 	PositionView() {
 		reset(PositionState::DEFAULT);
 	}
 
+	// Compares the moves updated after every ply against the full generator, on by default in debug builds
+	// A difference is reported through EngineLog and the full generator's moves are used instead
+	static void setCheckUpdatedMoves(bool check) {
+		checkUpdatedMoves().store(check, std::memory_order_relaxed);
+	}
+
+	// Updates that differed from the full generator since the process started
+	static uint64_t updatedMovesMismatches() {
+		return mismatchedUpdates().load(std::memory_order_relaxed);
+	}
+
+	// Views without overlays skip the shared move cache and the destinations and attacks the board draws,
+	// for simulations that only play moves
+	// Without them validDestinations only knows the latest ply and the attacks are worked out on every call
+	void setOverlays(bool overlays) {
+		m_overlays = overlays;
+		if (overlays) {
+			cacheDestinations(m_nodes.size() - 1, m_tip.position);
+			cacheDestinations(m_current, m_view.position);
+		}
+	}
+
 	size_t size() const {
-		return m_details.size();
+		return m_deltas.size();
 	}
 
 	void reset(const Position &position) {
 		m_session.setPosition(position);
+		m_sessionBase = 0;
 
 		Detail firstDetail;
 		firstDetail.position = position;
 		firstDetail.move = moves::Move::EMPTY;
 
-		common::Bitboard occupancySummary = position.occupancySummary();
+		common::Bitboard occupancySummary = position.occupancySummary() & ~position.walls(); // Walls are not pieces and get no id
 		size_t id = 0;
 		while (occupancySummary != 0) {
 			const common::Square square(occupancySummary);
 			occupancySummary = occupancySummary.popLsb();
 
 			firstDetail.maps.square_id[square] = id;
-			firstDetail.maps.id_square[id] = square;
+			firstDetail.maps.id_square[id] = square.get_raw_value();
 			++id;
 		}
 
-		m_details.clear();
-		m_details.push_back(firstDetail);
+		m_deltas.clear();
+		m_deltas.push_back(Delta());
+		m_keyframes.clear();
+		m_keyframes.push_back(Keyframe{ 0, position, firstDetail.maps });
 
+		m_tree.reset(hashOf(position));
+		m_cachedNodes.clear();
+		m_nodes.clear();
+		m_nodes.push_back(m_tree.root());
+		rebuildPlyHashes();
+
+		m_tip = firstDetail;
+		m_view = firstDetail;
 		m_current = 0;
+		m_generated.fill(Generated());
+		m_redo.clear();
+		m_notations.assign(1, AlgebraicNotation());
+		m_tipParent.reset();
 		computeValidMoves();
+		writeJournalBase();
 	}
 
 	const Position &current() const {
-		return m_details[m_current].position;
+		return m_view.position;
 	}
 
-	AlgebraicPieceAndSquareOffset makeMove(moves::Move &move) {
+	// Returns the animation offsets of the move, nothing when the move is not valid
+	std::optional<PieceAndSquareOffset> makeMove(moves::Move &move) {
 		using namespace moves;
 		using namespace common;
 
-		AlgebraicPieceAndSquareOffset result;
+		if (!isValidMove(move.from(), move.to())) {
+			return {};
+		}
+
+		// Moves made while reviewing an earlier ply continue from that ply
+		if (m_current != m_deltas.size() - 1) {
+			truncate(m_current);
+		}
 
-		const std::optional<Move> &realMove = PositionMoves::findRealMove(m_validMoves, move);
+		const std::optional<Move> &realMove = findValidMove(move);
 		if (!realMove) {
-			return result;
+			return {};
 		}
 		move = *realMove;
 
-		result.algebraic_notation = PositionMoves::algebraicNotation(m_session.position(), move);
+		// Repeating the last undone move keeps the rest of the redo stack
+		if (!m_redo.empty() && m_redo.back().delta.move == move) {
+			m_redo.pop_back();
+		} else {
+			m_redo.clear();
+		}
 
+		// Notation is generated on request, keep what it needs for the latest ply
+		m_tipParent = m_session.position();
+
+		PieceAndSquareOffset result;
 		const Result &moveResult = m_session.makeMove(*realMove);
-		if (moveResult.slide && moveResult.slide != FieldIndex::ZERO) {
-			Bitboard walls = m_session.position().walls();
-			const FieldIndex fixedSlide(moveResult.slide->x, -moveResult.slide->y);
-			while (walls > 0) {
-				const Square wall(Square(walls).asFieldIndex() + fixedSlide);
-				result.squares[wall] = Square(walls);
-				walls = walls.popLsb();
+		const WallSlides::Slide *slide = moveResult.slide && moveResult.slide != FieldIndex::ZERO
+				? WallSlides::between(m_tipParent->walls().get_raw_value(), m_session.position().walls().get_raw_value())
+				: nullptr;
+		if (slide) {
+			for (uint64_t walls = slide->to; walls != 0; walls &= walls - 1) {
+				const size_t wall = WallSlides::lowestSquare(walls);
+				result.squares[wall - slide->offset] = Square(wall);
 			}
 
-			walls = m_session.position().walls();
 			for (size_t i = 0; i < moveResult.moved.size(); ++i) {
-				if ((walls & moveResult.moved[i].to.asBitboard()) == 0) {
+				const uint64_t to = moveResult.moved[i].to.asBitboard().get_raw_value();
+				if ((slide->to & to) == 0) {
 					result.pieces[moveResult.moved[i].to] = moveResult.moved[i].from;
 				} else {
-					const Square slide_to(Square(moveResult.moved[i].to).asFieldIndex() + fixedSlide);
+					const Square slide_to(static_cast<size_t>(moveResult.moved[i].to.get_raw_value() - slide->offset));
 					result.pieces[slide_to] = moveResult.moved[i].from;
 				}
 			}
@@ -178,59 +342,353 @@ public:
 			}
 		}
 
-		Detail detail;
-		detail.position = m_session.position();
-		detail.move = *realMove;
-		detail.maps = m_details.peek().maps;
-		detail.update_maps(moveResult);
-		m_details.push_back(detail);
-		m_current = m_details.size() - 1;
+		Delta delta;
+		delta.move = *realMove;
+		if (moveResult.slide) {
+			delta.slide_x = moveResult.slide->x;
+			delta.slide_y = moveResult.slide->y;
+		}
 
-		computeValidMoves();
+		m_tip.position = m_session.position();
+		m_tip.move = *realMove;
+		delta.captured = m_tip.update_maps(moveResult);
+
+		pushDelta(delta);
 
+		if (!updateValidMoves()) {
+			computeValidMoves();
+		}
+
+		journal(MoveJournal::MOVE, realMove->from().get_raw_value(), realMove->to().get_raw_value(), realMove->flags().get_raw_value());
 		return result;
 	}
 
-	// Undo the last move
-	PieceAndSquareOffset undo() {
-		if (m_details.size() <= 1) {
-			return PieceAndSquareOffset();
+	// Undo the last move, nothing when there is no move to undo
+	std::optional<PieceAndSquareOffset> undo() {
+		if (m_deltas.size() <= 1) {
+			return {};
 		}
 
-		moves::Move lastMove = m_details.peek().move;
-		if (lastMove != moves::Move::EMPTY)
-			m_session.undoMove(m_details.peek().move);
+		const Detail lastDetail = m_tip;
+		const Delta lastDelta = m_deltas.back();
+
+		Redo redo{ lastDelta, m_nodes.back(), lastDetail };
+
+		m_deltas.pop_back();
+		m_nodes.pop_back();
+		if (m_keyframes.back().ply == m_deltas.size()) {
+			redo.keyframe = m_keyframes.back();
+			m_keyframes.pop_back();
+		}
+
+		const size_t tip = m_deltas.size() - 1;
+		materialize(tip, m_tip);
+		forgetGeneratedAfter(tip);
+		rebuildPlyHashes();
+
+		// Moves are kept for redo, placing walls can only be repeated by placing them again
+		// Redo is journaled as the move it repeats, so a ply whose walls were slid after the move is not kept either
+		// Such plies are stored whole as keyframes, only those have to be played again to tell
+		if (lastDelta.move != moves::Move::EMPTY && (!redo.keyframe || replaysTo(lastDelta.move, lastDetail.position))) {
+			redo.validMoves = m_validMoves;
+			redo.notation = m_notations.back();
+			m_redo.push_back(redo);
+		} else {
+			m_redo.clear();
+		}
+		m_notations.pop_back();
+		m_tipParent.reset();
+
+		// The session can only step back through moves it made itself
+		if (lastDelta.move != moves::Move::EMPTY && tip >= m_sessionBase) {
+			m_session.undoMove(lastDelta.move);
+		} else {
+			m_session.setPosition(m_tip.position);
+			m_sessionBase = tip;
+		}
 		computeValidMoves();
 
-		const PieceAndSquareOffset &result = calculateOffsets(m_details[m_details.size() - 1], m_details[m_details.size() - 2]);
+		const PieceAndSquareOffset &result = calculateOffsets(lastDetail, m_tip);
+
+		m_view = m_tip;
+		m_current = tip;
+
+		journal(MoveJournal::UNDO);
+		return result;
+	}
+
+	bool canRedo() const {
+		return !m_redo.empty();
+	}
+
+	// Restores the last undone move and views it, nothing is replayed or generated again
+	// Journaled as the move it repeats, a recovered game has no redo stack but replays the move the same way
+	std::optional<PieceAndSquareOffset> redo() {
+		if (m_redo.empty()) {
+			return {};
+		}
+
+		// The move is replayed from the latest ply, view it first so the journal does the same
+		const Detail fromDetail = m_view;
+		seek(m_deltas.size() - 1);
+
+		Redo redo = std::move(m_redo.back());
+		m_redo.pop_back();
+
+		m_deltas.push_back(redo.delta);
+		m_nodes.push_back(redo.node);
+		m_notations.push_back(redo.notation);
+		recordPlyHash(m_deltas.size() - 1);
+		m_tipParent.reset();
+		if (redo.keyframe) {
+			m_keyframes.push_back(*redo.keyframe);
+		}
+
+		const size_t tip = m_deltas.size() - 1;
+		m_tip = redo.detail;
+		m_session.setPosition(m_tip.position);
+		m_sessionBase = tip;
 
-		m_details.pop_back();
-		m_current = m_details.size() - 1;
+		const size_t color = tipColor();
+		for (size_t square = 0; square < m_validMovesMap[color].size(); ++square) {
+			clearValidMoves(color, square);
+		}
+		for (size_t i = 0; i < redo.validMoves.size(); ++i) {
+			addValidMove(color, redo.validMoves[i]);
+		}
+		finishValidMoves(color);
 
+		const PieceAndSquareOffset &result = calculateOffsets(fromDetail, m_tip);
+
+		m_view = m_tip;
+		m_current = tip;
+
+		const moves::Move move = redo.delta.move;
+		journal(MoveJournal::MOVE, move.from().get_raw_value(), move.to().get_raw_value(), move.flags().get_raw_value());
 		return result;
 	}
 
-	// View a specific state
-	PieceAndSquareOffset seek(size_t index) {
+	// Move that led to the currently viewed state, EMPTY for the start and placed walls
+	moves::Move currentMove() const {
+		return m_view.move;
+	}
+
+	// Times the latest position occurred within the last REPETITION_PLIES plies, counting itself
+	size_t repetitions() const {
+		return m_plyHashes[(m_deltas.size() - 1) % REPETITION_PLIES].repetitions;
+	}
+
+	bool isThreefoldRepetition() const {
+		return repetitions() >= 3;
+	}
+
+	// Move of a ply, EMPTY for the start and placed walls
+	moves::Move move(size_t ply) const {
+		return m_deltas[ply].move;
+	}
+
+	// Algebraic notation of a ply, generated the first time it is requested
+	// The start and placed walls have no notation
+	const AlgebraicNotation &notation(size_t ply) {
+		AlgebraicNotation &notation = m_notations[ply];
+		if (notation[0] != '\0' || m_deltas[ply].move == moves::Move::EMPTY) {
+			return notation;
+		}
+
+		if (ply == m_deltas.size() - 1 && m_tipParent) {
+			notation = PositionMoves::algebraicNotation(*m_tipParent, m_deltas[ply].move);
+		} else {
+			Detail parent;
+			materialize(ply - 1, parent);
+			notation = PositionMoves::algebraicNotation(parent.position, m_deltas[ply].move);
+		}
+		return notation;
+	}
+
+	// Generates the notation of every ply that does not have it yet with a single replay
+	void generateNotations() {
+		size_t ply = 1;
+		while (ply < m_deltas.size() && (m_deltas[ply].move == moves::Move::EMPTY || m_notations[ply][0] != '\0')) {
+			++ply;
+		}
+		if (ply >= m_deltas.size()) {
+			return;
+		}
+
+		Detail detail;
+		materialize(ply - 1, detail);
+		m_replay.setPosition(detail.position);
+
+		auto keyframe = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), ply - 1, [](size_t index, const Keyframe &keyframe) {
+			return index < keyframe.ply;
+		});
+		for (; ply < m_deltas.size(); ++ply) {
+			const Delta &delta = m_deltas[ply];
+			if (delta.move != moves::Move::EMPTY && m_notations[ply][0] == '\0') {
+				m_notations[ply] = PositionMoves::algebraicNotation(m_replay.position(), delta.move);
+			}
+
+			// Keyframes also hold positions that can not be replayed, such as slid walls
+			if (keyframe != m_keyframes.end() && keyframe->ply == ply) {
+				m_replay.setPosition(keyframe->position);
+				++keyframe;
+			} else if (delta.move == moves::Move::EMPTY) {
+				Position position = m_replay.position();
+				PackedPosition::placeWalls(position, delta.wall);
+				m_replay.setPosition(position);
+			} else {
+				m_replay.makeMove(delta.move);
+			}
+		}
+	}
+
+	// View a specific state, nothing when it does not exist or is already viewed
+	std::optional<PieceAndSquareOffset> seek(size_t index) {
 		using namespace common;
 
-		if (index >= m_details.size()) {
-			return PieceAndSquareOffset();
+		if (index >= m_deltas.size() || index == m_current) {
+			return {};
 		}
 
-		const Detail &fromDetail = m_details[m_current];
+		const Detail fromDetail = m_view;
+		if (index == m_deltas.size() - 1) {
+			m_view = m_tip;
+		} else {
+			materialize(index, m_view);
+		}
 		m_current = index;
-		return calculateOffsets(fromDetail, m_details[index]);
+		cacheDestinations(index, m_view.position);
+		journal(MoveJournal::SEEK, index & 0xFF, (index >> 8) & 0xFF, (index >> 16) & 0xFF);
+		return calculateOffsets(fromDetail, m_view);
 	}
 
-	// List of valid moves for the currently viewed state
+	// List of valid moves for the latest state
 	const moves::Moves &validMoves() const {
 		return m_validMoves;
 	}
 
-	// List of valid moves for the currently viewed state for the requested square
-	const common::FastVector<moves::Move, 21> &validMoves(common::Square square) const {
-		return m_validMovesMap[square];
+	// List of valid moves for the latest state for the requested square
+	const SquareMoves &validMoves(common::Square square) const {
+		return m_validMovesMap[tipColor()][square];
+	}
+
+	// Squares the piece on the requested square can move to in the currently viewed state
+	// Empty for earlier plies when they are not cached
+	common::Bitboard validDestinations(common::Square square) const {
+		if (const ValidDestinations *destinations = viewedDestinations()) {
+			return destinations->squares[square];
+		}
+		if (m_current != m_deltas.size() - 1) {
+			return common::Bitboard(0);
+		}
+
+		common::Bitboard squares(0);
+		const SquareMoves &moves = validMoves(square);
+		for (size_t i = 0; i < moves.size(); ++i) {
+			squares |= moves[i].to().asBitboard();
+		}
+		return squares;
+	}
+
+	// Squares attacked by the color in the currently viewed state
+	common::Bitboard attackedSquares(common::PieceColor color) const {
+		const ValidDestinations *destinations = viewedDestinations();
+		return destinations ? destinations->attacked[color.get_raw_value()] : common::Bitboard(AttackMaps::attacked(m_view.position, color));
+	}
+
+	// Pieces of the color pinned to their king in the currently viewed state
+	common::Bitboard pinnedPieces(common::PieceColor color) const {
+		const ValidDestinations *destinations = viewedDestinations();
+		return destinations ? destinations->pinned[color.get_raw_value()] : common::Bitboard(AttackMaps::pinned(m_view.position, color));
+	}
+
+	// Pieces giving check to the side to move in the currently viewed state
+	common::Bitboard checkers() const {
+		const ValidDestinations *destinations = viewedDestinations();
+		return destinations ? destinations->checkers : common::Bitboard(AttackMaps::checkers(m_view.position, m_view.position.colorToMove()));
+	}
+
+	// Whether a piece can move between the squares in the currently viewed state
+	bool isValidMove(common::Square from, common::Square to) const {
+		if (m_current == m_deltas.size() - 1) {
+			return m_moveIndex[tipColor()][from][to] != NO_MOVE_INDEX;
+		}
+		if (m_overlays) {
+			return (validDestinations(from) & to.asBitboard()) != 0;
+		}
+
+		moves::Moves viewedMoves;
+		generateValidMoves(m_view.position, viewedMoves);
+		for (size_t i = 0; i < viewedMoves.size(); ++i) {
+			if (viewedMoves[i].from() == from && viewedMoves[i].to() == to) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Valid move of the latest state matching the squares of the requested move
+	// Promotions only match the requested flags unless the move is QUIET
+	std::optional<moves::Move> findValidMove(moves::Move move) const {
+		const size_t color = tipColor();
+		const uint8_t index = m_moveIndex[color][move.from()][move.to()];
+		if (index == NO_MOVE_INDEX) {
+			return {};
+		}
+
+		const SquareMoves &squareMoves = m_validMovesMap[color][move.from()];
+		if (move.flags() == moves::MoveFlags::QUIET || squareMoves[index].flags() == move.flags()) {
+			return squareMoves[index];
+		}
+
+		for (size_t i = index + 1; i < squareMoves.size(); ++i) {
+			if (squareMoves[i].to() == move.to() && squareMoves[i].flags() == move.flags()) {
+				return squareMoves[i];
+			}
+		}
+		return {};
+	}
+
+	// Valid move of the currently viewed state written in UCI notation, the state makeMove plays from
+	// Promotions only match with their piece, nothing when the notation matches no move
+	std::optional<moves::Move> findUciMove(std::string_view uci) const {
+		if (uci.size() != 4 && uci.size() != 5) {
+			return {};
+		}
+
+		const std::optional<common::Square> from = PackedPosition::parseSquare(uci.substr(0, 2));
+		if (!from || !PackedPosition::parseSquare(uci.substr(2, 2))) {
+			return {};
+		}
+
+		auto matches = [uci](moves::Move move) {
+			return std::string_view(move.asUciNotation().data()) == uci;
+		};
+
+		if (m_current == m_deltas.size() - 1) {
+			const SquareMoves &squareMoves = m_validMovesMap[tipColor()][*from];
+			for (size_t i = 0; i < squareMoves.size(); ++i) {
+				if (matches(squareMoves[i])) {
+					return squareMoves[i];
+				}
+			}
+			return {};
+		}
+
+		moves::Moves viewedMoves;
+		generateValidMoves(m_view.position, viewedMoves);
+		for (size_t i = 0; i < viewedMoves.size(); ++i) {
+			if (viewedMoves[i].from() == *from && matches(viewedMoves[i])) {
+				return viewedMoves[i];
+			}
+		}
+		return {};
+	}
+
+	// Moves explored from the currently viewed state, including lines that were left
+	template <size_t N>
+	void variations(common::FastVector<moves::Move, N> &moves) const {
+		m_tree.continuations(m_nodes[m_current], moves);
 	}
 
 	// Highlight squares involved in the currently viewed state
@@ -240,17 +698,23 @@ public:
 		using namespace phase4::engine::moves;
 
 		FastVector<Square, 4> squares;
-		const Detail &detail = m_details[m_current];
+		const Detail &detail = m_view;
 		if (detail.move == moves::Move::EMPTY) {
 			return squares;
 		}
 
-		const Bitboard fromWall = m_details[m_current - 1].position.walls();
-		const Bitboard toWall = detail.position.walls();
-		const FieldIndex slideDir = fromWall == 0 || toWall == 0 ? FieldIndex::ZERO : WallOperations::SLIDE_DIR[Square(fromWall)][Square(toWall)];
+		// The squares of the move are where they were before the walls slid, the ones the walls moved onto were pushed back
+		const FieldIndex slideDir = m_deltas[m_current].slide();
+		const uint64_t walls = detail.position.walls().get_raw_value();
+		const WallSlides::Slide *back = WallSlides::find(WallSlides::lowestSquare(walls), (-slideDir).offset());
+		const WallSlides::Slide *slide = back ? WallSlides::between(back->to, walls) : nullptr;
+		const auto slid = [slide](Square square) {
+			const uint64_t bitboard = square.asBitboard().get_raw_value();
+			return slide ? Square(WallSlides::lowestSquare(WallSlides::push(*slide, bitboard))) : square;
+		};
 
-		squares.push_back(detail.move.from());
-		squares.push_back(Square(detail.move.to() + (-slideDir).offset()));
+		squares.push_back(slid(detail.move.from()));
+		squares.push_back(slid(detail.move.to()));
 
 		// TODO: Show rook highlights from castling
 		switch (detail.position.colorToMove().get_raw_value()) {
@@ -277,115 +741,1200 @@ public:
 		return squares;
 	}
 
+	// Slides the walls one step by shifting the bitboards of the position with the table, the hash is left to slideHash
+	static void applySlide(Position &position, const WallSlides::Slide &slide) {
+		using namespace common;
+
+		for (PieceColor color = PieceColor::WHITE; color != PieceColor::INVALID; ++color) {
+			for (PieceType type = PieceType::PAWN; type != PieceType::INVALID; ++type) {
+				Bitboard &pieces = position.colorPieceMask(color, type);
+				pieces = Bitboard(WallSlides::push(slide, pieces.get_raw_value()));
+			}
+		}
+
+		position.occupancySummary() = Bitboard(WallSlides::push(slide, position.occupancySummary().get_raw_value() & ~slide.from) | slide.to);
+		position.walls() = Bitboard(slide.to);
+	}
+
+	// Hash of a position after its walls slid, updated from the hash before the slide
+	// Pieces carried along by the walls are moved in the hash as well
+	static ZobristHashing slideHash(const Position &before, const Position &after) {
+		using namespace common;
+
+		ZobristHashing hash = before.hash().toggleWalls(before.walls()).toggleWalls(after.walls());
+		for (PieceColor color = PieceColor::WHITE; color != PieceColor::INVALID; ++color) {
+			for (PieceType type = PieceType::PAWN; type != PieceType::INVALID; ++type) {
+				uint64_t changed = before.colorPieceMask(color, type).get_raw_value() ^ after.colorPieceMask(color, type).get_raw_value();
+				while (changed != 0) {
+					hash = hash.addOrRemovePiece(color, type, Square(AttackMaps::lowest(changed)));
+					changed &= changed - 1;
+				}
+			}
+		}
+		return hash;
+	}
+
 	void setWalls(common::Square square) {
 		using namespace common;
 		using namespace board;
 
-		if (m_details.is_empty()) {
+		if (m_deltas.empty()) {
 			return;
 		}
 
-		Position position = m_details.peek().position;
-
-		if (position.walls() > 0) {
-			return; // This might not be safe if pieces get removed
-			// TODO: Allow this to happen
-			// Remove old walls
-			position.occupancySummary() &= ~position.walls();
-			position.hash() = position.hash().toggleWalls(position.walls());
+		Position position = m_tip.position;
+		if (!PackedPosition::placeWalls(position, square)) {
+			return;
 		}
 
-		position.walls() = WallOperations::SLIDE_FROM[square];
-		position.occupancySummary() |= position.walls();
-		position.hash() = position.hash().toggleWalls(position.walls());
-
 		m_session.setPosition(position);
+		m_redo.clear();
+		m_tipParent.reset();
 
-		Detail detail;
-		detail.position = position;
-		detail.move = moves::Move::EMPTY; // No pieces moved, only squares
-		detail.maps = m_details.peek().maps; // No pieces should move
-		m_details.push_back(detail);
-		m_current = m_details.size() - 1;
+		Delta delta;
+		delta.move = moves::Move::EMPTY; // No pieces moved, only squares
+		delta.wall = square;
+
+		m_tip.position = position;
+		m_tip.move = moves::Move::EMPTY; // No pieces should move
+		pushDelta(delta);
+		m_sessionBase = m_current;
 
 		computeValidMoves();
+		journal(MoveJournal::WALLS, square.get_raw_value());
 	}
 
-	PieceAndSquareOffset slideWalls(common::FieldIndex wallMove, bool addHistory = false) {
+	std::optional<PieceAndSquareOffset> slideWalls(common::FieldIndex wallMove, bool addHistory = false) {
+		return slideWallsBy(wallMove, addHistory);
+	}
+
+	// Slides the walls along one axis by any number of two square steps as a single change
+	// Only the final position is given to the session and has its valid moves generated
+	// The offsets map every square and piece the walls pushed aside to where it was before the slide
+	// Nothing when the walls could not move in the direction
+	std::optional<PieceAndSquareOffset> slideWallsBy(common::FieldIndex direction, bool addHistory = false) {
 		using namespace common;
 		using namespace board;
 
 		PieceAndSquareOffset offsets;
 
-		if (m_details.is_empty()) {
-			return offsets;
+		if (m_deltas.empty() || (direction.x != 0 && direction.y != 0) || direction.x % 2 != 0 || direction.y % 2 != 0 || direction == FieldIndex::ZERO) {
+			return {};
+		}
+
+		const FieldIndex step(direction.x == 0 ? 0 : (direction.x > 0 ? 2 : -2), direction.y == 0 ? 0 : (direction.y > 0 ? 2 : -2));
+		const size_t steps = std::abs(direction.x + direction.y) / 2;
+
+		// Steps that would leave the board are known from the table and skipped
+		Detail slid = m_tip;
+		for (size_t i = 0; i < steps; ++i) {
+			const WallSlides::Slide *slide = WallSlides::find(WallSlides::lowestSquare(slid.position.walls().get_raw_value()), step.offset());
+			if (!slide) {
+				break;
+			}
+			applySlide(slid.position, *slide);
+			slid.slide_maps(step);
 		}
 
-		Detail &lastDetail = m_details.peek();
-		Position position = lastDetail.position;
-		const PositionMoves::SlideResult result = PositionMoves::slideWall(position, wallMove);
-		// TODO: compute hash
+		const uint64_t fromWalls = m_tip.position.walls().get_raw_value();
+		const uint64_t toWalls = slid.position.walls().get_raw_value();
+		if (fromWalls == toWalls) {
+			return {};
+		}
+
+		std::array<uint8_t, 64> origin;
+		if (WallSlides::origins(fromWalls, toWalls, origin)) {
+			addSlideOffsets(origin, toWalls, slid.position.occupancySummary().get_raw_value(), offsets);
+		}
+
+		Position position = slid.position;
+		position.hash() = slideHash(m_tip.position, position);
 		m_session.setPosition(position);
+		m_redo.clear();
+		m_generated.fill(Generated()); // Pieces moved outside of a ply, earlier moves can not be reused
 
 		if (addHistory) {
-			// TODO: add to history
+			// A ply of its own that only slid the walls, stored whole since it can not be replayed
+			Delta delta;
+			delta.move = moves::Move::EMPTY;
+			delta.slide_x = static_cast<int8_t>(direction.x);
+			delta.slide_y = static_cast<int8_t>(direction.y);
+
+			m_tip.position = position;
+			m_tip.move = moves::Move::EMPTY;
+			m_tip.maps = slid.maps;
+			m_tipParent.reset();
+			pushDelta(delta);
+
+			m_sessionBase = m_deltas.size() - 1;
+			if (m_keyframes.back().ply != m_sessionBase) {
+				m_keyframes.push_back(Keyframe{ m_sessionBase, position, m_tip.maps });
+			}
 		} else {
-			lastDetail.position = position;
-			// TODO: update maps if pieces moved
+			m_sessionBase = m_deltas.size() - 1;
+			m_tip.position = position;
+			m_tip.maps = slid.maps;
+
+			// The slid position can not be replayed from a delta so store it whole
+			if (m_keyframes.back().ply == m_sessionBase) {
+				m_keyframes.back().position = position;
+				m_keyframes.back().maps = m_tip.maps;
+			} else {
+				m_keyframes.push_back(Keyframe{ m_sessionBase, position, m_tip.maps });
+			}
+
+			if (m_current == m_sessionBase) {
+				m_view = m_tip;
+			}
+
+			// The slid position is a different node than the one reached by the last ply
+			if (m_sessionBase == 0) {
+				m_nodes[0] = m_tree.findOrAdd(hashOf(position));
+			} else {
+				const Delta &delta = m_deltas[m_sessionBase];
+				m_nodes[m_sessionBase] = m_tree.play(m_nodes[m_sessionBase - 1], delta.move, delta.wall, hashOf(position));
+			}
+			recordPlyHash(m_sessionBase);
 		}
 
 		computeValidMoves();
+		journal(MoveJournal::SLIDE, static_cast<uint8_t>(direction.x), static_cast<uint8_t>(direction.y), addHistory);
 
 		return offsets;
 	}
 
+	// Snapshots are a header followed by a record per ply and one per keyframe, written field by field
+	// Keyframe positions are stored as PackedPosition so neither padding nor the engine's layout reaches the bytes
+	// Only the current line is stored, the variation tree, redo stack and notations start over on restore
+	static constexpr uint32_t SNAPSHOT_MAGIC = 0x4E533450; // P4SN
+	static constexpr uint32_t SNAPSHOT_VERSION = 2;
+
+	size_t snapshotSize() const {
+		return snapshotSize(m_deltas.size(), m_keyframes.size());
+	}
+
+	// Writes snapshotSize() bytes, the same game always gives the same bytes
+	void writeSnapshot(uint8_t *data) const {
+		data = writeValue(data, SNAPSHOT_MAGIC);
+		data = writeValue(data, SNAPSHOT_VERSION);
+		data = writeValue(data, static_cast<uint32_t>(m_deltas.size()));
+		data = writeValue(data, static_cast<uint32_t>(m_keyframes.size()));
+		data = writeValue(data, static_cast<uint32_t>(m_current));
+
+		for (const Delta &delta : m_deltas) {
+			data = writeValue(data, snapshotMove(delta.move));
+			data = writeValue(data, static_cast<uint8_t>(delta.wall.get_raw_value()));
+			data = writeValue(data, delta.slide_x);
+			data = writeValue(data, delta.slide_y);
+			data = writeValue(data, delta.captured);
+		}
+
+		for (const Keyframe &keyframe : m_keyframes) {
+			// A position that does not pack is written without kings, the snapshot is then rejected on restore
+			const PackedPosition packed = PackedPosition::pack(keyframe.position).value_or(PackedPosition());
+			data = writeValue(data, static_cast<uint32_t>(keyframe.ply));
+			data = writeValue(data, keyframe.position.hash().get_raw_value());
+			data = writeValue(data, packed);
+			data = writeValue(data, keyframe.maps.square_id);
+		}
+	}
+
+	// Bytes of the snapshot whose header is at the start of the data, 0 when the header is not valid or the data too short
+	// Only the header is read, the plies and keyframes are checked by restore
+	static size_t snapshotSize(const uint8_t *data, size_t size) {
+		if (size < SNAPSHOT_HEADER_SIZE) {
+			return 0;
+		}
+
+		uint32_t magic;
+		uint32_t version;
+		uint32_t plies;
+		uint32_t keyframes;
+		uint32_t current;
+		readValue(readValue(readValue(readValue(readValue(data, magic), version), plies), keyframes), current);
+		if (magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION || plies == 0 || keyframes == 0 || keyframes > plies || current >= plies) {
+			return 0;
+		}
+
+		const size_t snapshot = snapshotSize(plies, keyframes);
+		return size < snapshot ? 0 : snapshot;
+	}
+
+	// Replaces the game with a snapshot and returns the bytes read, nothing changes when it is not valid
+	// Snapshots come from files and other processes, every ply is replayed once and its move checked against the valid moves
+	size_t restore(const uint8_t *data, size_t size) {
+		if (snapshotSize(data, size) == 0) {
+			return 0;
+		}
+
+		// Storage is sized from the header up front so the replay adds plies without allocating
+		uint32_t plies;
+		uint32_t keyframeCount;
+		uint32_t current;
+		readValue(readValue(readValue(data + 2 * sizeof(uint32_t), plies), keyframeCount), current);
+		std::vector<Delta> deltas;
+		deltas.reserve(plies);
+		std::vector<Keyframe> keyframes;
+		keyframes.reserve(keyframeCount);
+		std::vector<uint64_t> hashes;
+		hashes.reserve(plies);
+
+		// The game is only replaced once the whole snapshot replayed
+		const size_t snapshot = replaySnapshot(data, size, m_replay, [&](const Delta &delta, const Position &position, const Keyframe *keyframe) {
+			if (keyframe) {
+				keyframes.push_back(*keyframe);
+			}
+			deltas.push_back(delta);
+			hashes.push_back(hashOf(position));
+		});
+		if (snapshot == 0) {
+			return 0;
+		}
+
+		m_deltas = std::move(deltas);
+		m_keyframes = std::move(keyframes);
+		m_notations.assign(plies, AlgebraicNotation());
+		m_cachedNodes.clear();
+		m_nodes.clear();
+		m_nodes.reserve(plies);
+		m_tree.reset(hashes[0]);
+		m_tree.reserve(plies);
+		m_nodes.push_back(m_tree.root());
+		for (size_t ply = 1; ply < plies; ++ply) {
+			m_nodes.push_back(m_tree.play(m_nodes.back(), m_deltas[ply].move, m_deltas[ply].wall, hashes[ply]));
+		}
+		rebuildPlyHashes();
+
+		const size_t tip = plies - 1;
+		materialize(tip, m_tip);
+		m_session.setPosition(m_tip.position);
+		m_sessionBase = tip;
+		m_generated.fill(Generated());
+		m_redo.clear();
+		m_tipParent.reset();
+		computeValidMoves();
+
+		m_view = m_tip;
+		m_current = current;
+		if (m_current != tip) {
+			materialize(m_current, m_view);
+			cacheDestinations(m_current, m_view.position);
+		}
+
+		writeJournalBase();
+		return snapshot;
+	}
+
+	// Changes are appended to the journal until it is detached, the journal must already hold the game as its base
+	void setJournal(MoveJournal *journal) {
+		m_journal = journal;
+	}
+
+	// Restores the base of a journal and applies its records up to the first one that does not apply
+	// Returns false when the base is not a valid snapshot
+	bool replay(const MoveJournal::Contents &contents) {
+		MoveJournal *journal = m_journal;
+		m_journal = nullptr;
+
+		const bool restored = restore(contents.base.data(), contents.base.size()) != 0;
+		for (size_t i = 0; restored && i < contents.records.size() && applyJournalRecord(contents.records[i]); ++i) {
+		}
+
+		// The journal continues from the recovered game
+		m_journal = journal;
+		writeJournalBase();
+		return restored;
+	}
+
+	// Changes are passed to the sink until it is detached, in addition to the journal
+	void setRecordSink(RecordSink *sink) {
+		m_sink = sink;
+	}
+
+	// Applies a record from a journal or another process, false when it does not apply to the game
+	bool apply(const MoveJournal::Record &record) {
+		return applyJournalRecord(record);
+	}
+
 private:
-	PieceAndSquareOffset calculateOffsets(const Detail &fromDetail, const Detail &toDetail) const {
+	void journal(MoveJournal::Type type, uint8_t first = 0, uint8_t second = 0, uint8_t third = 0) {
+		if (m_journal) {
+			m_journal->append(type, first, second, third);
+		}
+
+		if (m_sink) {
+			MoveJournal::Record record;
+			record.type = type;
+			record.operands = { first, second, third };
+			m_sink->record(record, current().hash().get_raw_value());
+		}
+	}
+
+	// A game replaced as a whole starts the journal over from it and is passed to the sink
+	void writeJournalBase() {
+		if (m_sink) {
+			m_sink->replaced(*this);
+		}
+
+		if (!m_journal || !m_journal->isOpen()) {
+			return;
+		}
+
+		std::vector<uint8_t> base(snapshotSize());
+		writeSnapshot(base.data());
+		m_journal->rebase(base.data(), base.size());
+	}
+
+	bool applyJournalRecord(const MoveJournal::Record &record) {
 		using namespace common;
 
-		PieceAndSquareOffset result;
+		const auto &operands = record.operands;
+		switch (record.type) {
+			case MoveJournal::MOVE: {
+				// Moves were recorded with their flags, find the same move among the valid ones
+				if (m_current != m_deltas.size() - 1) {
+					truncate(m_current);
+				}
 
-		for (Square square = Square::BEGIN; square != Square::INVALID; ++square) {
-			if (fromDetail.maps.id_square[square] != Square::INVALID && toDetail.maps.id_square[square] != common::Square::INVALID) {
-				if (toDetail.maps.id_square[square] != fromDetail.maps.id_square[square]) {
-					result.pieces[toDetail.maps.id_square[square]] = fromDetail.maps.id_square[square];
+				const SquareMoves &squareMoves = validMoves(Square(static_cast<size_t>(operands[0])));
+				for (size_t i = 0; i < squareMoves.size(); ++i) {
+					moves::Move move = squareMoves[i];
+					if (move.to().get_raw_value() == operands[1] && move.flags().get_raw_value() == operands[2]) {
+						return makeMove(move).has_value();
+					}
 				}
+				return false;
 			}
+			case MoveJournal::WALLS: {
+				const size_t size = m_deltas.size();
+				setWalls(Square(static_cast<size_t>(operands[0])));
+				return m_deltas.size() != size;
+			}
+			case MoveJournal::SLIDE:
+				return slideWallsBy(FieldIndex(static_cast<int8_t>(operands[0]), static_cast<int8_t>(operands[1])), operands[2] != 0).has_value();
+			case MoveJournal::UNDO:
+				return undo().has_value();
+			case MoveJournal::REDO:
+				return redo().has_value();
+			case MoveJournal::SEEK:
+				return seek(operands[0] | (operands[1] << 8) | (operands[2] << 16)).has_value();
+		}
+		return false;
+	}
+
+	static constexpr size_t SNAPSHOT_HEADER_SIZE = 5 * sizeof(uint32_t); // Magic, version, plies, keyframes and viewed ply
+	static constexpr size_t SNAPSHOT_DELTA_SIZE = sizeof(uint16_t) + 4;
+	static constexpr size_t SNAPSHOT_KEYFRAME_SIZE = sizeof(uint32_t) + sizeof(uint64_t) + sizeof(PackedPosition) + sizeof(Maps::square_id);
+
+	static size_t snapshotSize(size_t plies, size_t keyframes) {
+		return SNAPSHOT_HEADER_SIZE + plies * SNAPSHOT_DELTA_SIZE + keyframes * SNAPSHOT_KEYFRAME_SIZE;
+	}
+
+	template <typename T>
+	static uint8_t *writeValue(uint8_t *data, const T &value) {
+		static_assert(std::is_trivially_copyable_v<T>, "Snapshot values are copied as bytes");
+		std::memcpy(data, &value, sizeof(T));
+		return data + sizeof(T);
+	}
+
+	template <typename T>
+	static const uint8_t *readValue(const uint8_t *data, T &value) {
+		std::memcpy(&value, data, sizeof(T));
+		return data + sizeof(T);
+	}
+
+	// Moves are stored as from, to and flags like the book and the transposition table, 0 for EMPTY
+	static uint16_t snapshotMove(moves::Move move) {
+		return move == moves::Move::EMPTY ? 0 : static_cast<uint16_t>(move.from().get_raw_value() | (move.to().get_raw_value() << 6) | (move.flags().get_raw_value() << 12));
+	}
+
+	// Delta of a snapshot record with the stored move, nothing when a square, piece id or slide is out of range
+	// The move is left EMPTY, it is only known once it is found among the valid moves of the previous ply
+	static std::optional<Delta> readSnapshotDelta(const uint8_t *data, uint16_t &move) {
+		uint8_t wall;
+		Delta delta;
+		readValue(readValue(readValue(readValue(readValue(data, move), wall), delta.slide_x), delta.slide_y), delta.captured);
+		if ((wall >= 64 && wall != Maps::NO_SQUARE) || (delta.captured >= PackedPosition::MAX_PIECES && delta.captured != Maps::NO_ID) ||
+				std::abs(delta.slide_x) > 7 || std::abs(delta.slide_y) > 7) {
+			return {};
 		}
 
-		const Bitboard fromWall = fromDetail.position.walls();
-		const Bitboard toWall = toDetail.position.walls();
-		const FieldIndex slideDir = fromWall == 0 || toWall == 0 ? FieldIndex::ZERO : WallOperations::SLIDE_DIR[Square(fromWall)][Square(toWall)];
-		if (slideDir != FieldIndex::ZERO) {
-			Bitboard walls = toWall;
-			while (walls > 0) {
-				const Square wall(Square(walls).asFieldIndex() + FieldIndex(slideDir.x, -slideDir.y));
-				result.squares[wall] = Square(walls);
-				walls = walls.popLsb();
+		delta.wall = common::Square(static_cast<size_t>(wall));
+		return delta;
+	}
+
+	// Keyframe of a snapshot record, nothing when the position is not valid or a piece has no id
+	static std::optional<Keyframe> readSnapshotKeyframe(const uint8_t *data) {
+		using namespace common;
+
+		uint32_t ply;
+		uint64_t hash;
+		PackedPosition packed;
+		Keyframe keyframe;
+		readValue(readValue(readValue(readValue(data, ply), hash), packed), keyframe.maps.square_id);
+
+		std::optional<Position> position = packed.unpack();
+		if (!position) {
+			return {};
+		}
+
+		// Move generation expects a single king of each color
+		for (PieceColor color = PieceColor::WHITE; color != PieceColor::INVALID; ++color) {
+			const uint64_t kings = position->colorPieceMask(color, PieceType::KING).get_raw_value();
+			if (kings == 0 || (kings & (kings - 1)) != 0) {
+				return {};
 			}
 		}
 
+		// Ids index the square of every piece, each id is used once and every piece has one
+		const uint64_t pieces = (position->occupancySummary() & ~position->walls()).get_raw_value();
+		for (size_t square = 0; square < 64; ++square) {
+			const uint8_t id = keyframe.maps.square_id[square];
+			if (id == Maps::NO_ID) {
+				if ((pieces & (uint64_t(1) << square)) != 0) {
+					return {};
+				}
+				continue;
+			}
+
+			if (id >= PackedPosition::MAX_PIECES || keyframe.maps.id_square[id] != Maps::NO_SQUARE) {
+				return {};
+			}
+			keyframe.maps.id_square[id] = static_cast<uint8_t>(square);
+		}
+
+		keyframe.ply = ply;
+		keyframe.position = *position;
+		keyframe.position.hash() = ZobristHashing(hash); // Kept as written so the hashes continue the ones of the writer
+		return keyframe;
+	}
+
+	// Checks a snapshot and passes every ply to visit in order, with its position and the keyframe stored for it
+	// Plies are replayed on the session from the previous one, moves must be valid and only keyframes may slide the walls
+	// Returns the bytes of the snapshot, 0 when anything in it is not valid
+	template <typename Visit>
+	static size_t replaySnapshot(const uint8_t *data, size_t size, Session &session, Visit &&visit) {
+		const size_t snapshot = snapshotSize(data, size);
+		if (snapshot == 0) {
+			return 0;
+		}
+
+		uint32_t plies;
+		uint32_t keyframes;
+		readValue(readValue(data + 2 * sizeof(uint32_t), plies), keyframes);
+
+		const uint8_t *deltas = data + SNAPSHOT_HEADER_SIZE;
+		const uint8_t *keyframeRecords = deltas + plies * SNAPSHOT_DELTA_SIZE;
+		size_t nextKeyframe = 0;
+		Position position;
+		moves::Moves validMoves;
+		for (size_t ply = 0; ply < plies; ++ply) {
+			uint16_t move;
+			std::optional<Delta> delta = readSnapshotDelta(deltas + ply * SNAPSHOT_DELTA_SIZE, move);
+			if (!delta || (ply == 0 && move != 0)) {
+				return 0;
+			}
+
+			// The first ply and plies that only slid the walls can not be replayed, their keyframe holds them
+			const bool storedWhole = ply == 0 || (move == 0 && delta->wall == common::Square::INVALID);
+			if (!storedWhole && move != 0) {
+				validMoves.clear();
+				PositionMoves::getValidMoves(position, validMoves);
+				for (size_t i = 0; i < validMoves.size() && delta->move == moves::Move::EMPTY; ++i) {
+					delta->move = snapshotMove(validMoves[i]) == move ? validMoves[i] : moves::Move::EMPTY;
+				}
+				if (delta->move == moves::Move::EMPTY) {
+					return 0;
+				}
+
+				session.makeMove(delta->move);
+				position = session.position();
+			} else if (!storedWhole) {
+				if (!PackedPosition::placeWalls(position, delta->wall)) {
+					return 0;
+				}
+				session.setPosition(position);
+			}
+
+			// Keyframes are sorted by ply, one that is out of order is never reached and fails the count below
+			uint32_t keyframePly = UINT32_MAX;
+			if (nextKeyframe < keyframes) {
+				readValue(keyframeRecords + nextKeyframe * SNAPSHOT_KEYFRAME_SIZE, keyframePly);
+			}
+
+			if (keyframePly == ply) {
+				const std::optional<Keyframe> keyframe = readSnapshotKeyframe(keyframeRecords + nextKeyframe * SNAPSHOT_KEYFRAME_SIZE);
+				if (!keyframe) {
+					return 0;
+				}
+
+				++nextKeyframe;
+				position = keyframe->position;
+				session.setPosition(position);
+				visit(*delta, position, &*keyframe);
+			} else if (storedWhole) {
+				return 0;
+			} else {
+				visit(*delta, position, static_cast<const Keyframe *>(nullptr));
+			}
+		}
+
+		return nextKeyframe == keyframes ? snapshot : 0;
+	}
+
+	using MoveIndex = std::array<std::array<uint8_t, 64>, 64>;
+
+	static constexpr MoveIndex emptyMoveIndex() {
+		MoveIndex moveIndex{};
+		for (auto &to : moveIndex) {
+			for (uint8_t &index : to) {
+				index = NO_MOVE_INDEX;
+			}
+		}
+		return moveIndex;
+	}
+
+	// Identifies positions in the variation tree and the repetition window
+	static uint64_t hashOf(const Position &position) {
+		return PositionKey::of(position);
+	}
+
+	// Counts the occurrences of a ply's position within the window, which must hold the plies before it
+	// The ply is either the next one or the latest one again, whose position changed in place
+	void recordPlyHash(size_t ply) {
+		PlyHash &slot = m_plyHashes[ply % REPETITION_PLIES];
+
+		// The slot holds the ply leaving the window or the previous position of the same ply
+		if (ply < m_recordedPlies || ply >= REPETITION_PLIES) {
+			removeWindowHash(slot.hash);
+		}
+
+		slot.hash = m_tree.node(m_nodes[ply]).hash;
+		slot.repetitions = addWindowHash(slot.hash);
+		m_recordedPlies = ply + 1;
+	}
+
+	// Refills the window after plies were removed or replaced, the count of the latest ply is exact again
+	void rebuildPlyHashes() {
+		const size_t tip = m_nodes.size() - 1;
+		const size_t first = tip >= REPETITION_PLIES ? tip - REPETITION_PLIES + 1 : 0;
+		m_windowCounts.fill(WindowCount());
+		m_plyHashes.fill(PlyHash());
+		m_recordedPlies = first;
+		for (size_t ply = first; ply <= tip; ++ply) {
+			recordPlyHash(ply);
+		}
+	}
+
+	// Slot of the hash in the window counts, or the empty slot it would take
+	size_t windowSlot(uint64_t hash) const {
+		constexpr size_t mask = WINDOW_SLOTS - 1;
+		size_t slot = hash & mask;
+		while (m_windowCounts[slot].count != 0 && m_windowCounts[slot].hash != hash) {
+			slot = (slot + 1) & mask;
+		}
+		return slot;
+	}
+
+	// Returns the times the hash is in the window with this occurrence
+	uint32_t addWindowHash(uint64_t hash) {
+		WindowCount &entry = m_windowCounts[windowSlot(hash)];
+		entry.hash = hash;
+		return ++entry.count;
+	}
+
+	void removeWindowHash(uint64_t hash) {
+		constexpr size_t mask = WINDOW_SLOTS - 1;
+		size_t slot = windowSlot(hash);
+		if (m_windowCounts[slot].count == 0 || --m_windowCounts[slot].count != 0) {
+			return;
+		}
+
+		// Later entries of the probe sequence move back so none is cut off from its home slot by the empty one
+		for (size_t next = (slot + 1) & mask; m_windowCounts[next].count != 0; next = (next + 1) & mask) {
+			const size_t home = m_windowCounts[next].hash & mask;
+			if (((next - home) & mask) >= ((next - slot) & mask)) {
+				m_windowCounts[slot] = m_windowCounts[next];
+				m_windowCounts[next] = WindowCount();
+				slot = next;
+			}
+		}
+	}
+
+	// Appends a ply whose resulting state is already in m_tip and views it
+	void pushDelta(const Delta &delta) {
+		m_nodes.push_back(m_tree.play(m_nodes.back(), delta.move, delta.wall, hashOf(m_tip.position)));
+		m_deltas.push_back(delta);
+		m_notations.push_back(AlgebraicNotation());
+		const size_t ply = m_deltas.size() - 1;
+		recordPlyHash(ply);
+		if (ply - m_keyframes.back().ply >= KEYFRAME_INTERVAL) {
+			m_keyframes.push_back(Keyframe{ ply, m_tip.position, m_tip.maps });
+		}
+
+		m_view = m_tip;
+		m_current = ply;
+	}
+
+	// Whether playing the move from the latest ply leads to the position
+	bool replaysTo(moves::Move move, const Position &position) {
+		m_replay.setPosition(m_tip.position);
+		m_replay.makeMove(move);
+		const Position &played = m_replay.position();
+		return played.walls() == position.walls() && played.occupancySummary() == position.occupancySummary();
+	}
+
+	// Leaves the plies after the viewed one to the variation tree and continues the game from it
+	void truncate(size_t index) {
+		m_deltas.resize(index + 1);
+		m_nodes.resize(index + 1);
+		m_notations.resize(index + 1);
+		rebuildPlyHashes();
+		m_tipParent.reset();
+		while (m_keyframes.back().ply > index) {
+			m_keyframes.pop_back();
+		}
+
+		m_tip = m_view;
+		m_session.setPosition(m_tip.position);
+		m_sessionBase = index;
+		forgetGeneratedAfter(index);
+		m_redo.clear();
+		if (m_tree.size() > PRUNED_TREE_NODES) {
+			pruneTree();
+		}
+
+		computeValidMoves();
+	}
+
+	// Drops the lines that were left beyond their first ply, the redo stack must already be empty
+	void pruneTree() {
+		const std::vector<VariationTree::NodeId> remap = m_tree.prune(m_nodes);
+		for (VariationTree::NodeId &node : m_nodes) {
+			node = remap[node];
+		}
+
+		size_t cached = 0;
+		for (const VariationTree::NodeId node : m_cachedNodes) {
+			if (remap[node] != VariationTree::NONE) {
+				m_cachedNodes[cached++] = remap[node];
+			}
+		}
+		m_cachedNodes.resize(cached);
+	}
+
+	// Destinations of a node, which becomes the most recently used one
+	// A node without them takes over the allocation of the least recently used node once the cache is full
+	ValidDestinations &useDestinations(VariationTree::NodeId id) {
+		const auto cached = std::find(m_cachedNodes.begin(), m_cachedNodes.end(), id);
+		if (cached != m_cachedNodes.end()) {
+			m_cachedNodes.erase(cached);
+		}
+
+		std::unique_ptr<ValidDestinations> &destinations = m_tree.node(id).destinations;
+		if (!destinations) {
+			if (m_cachedNodes.size() >= CACHED_DESTINATIONS) {
+				// The viewed and latest plies are used without being looked up, they always keep theirs
+				const VariationTree::NodeId viewed = m_current < m_nodes.size() ? m_nodes[m_current] : VariationTree::NONE;
+				auto oldest = m_cachedNodes.begin();
+				while (*oldest == viewed || *oldest == m_nodes.back()) {
+					++oldest;
+				}
+				destinations = std::move(m_tree.node(*oldest).destinations);
+				m_cachedNodes.erase(oldest);
+			} else {
+				destinations = std::make_unique<ValidDestinations>();
+			}
+		}
+
+		m_cachedNodes.push_back(id);
+		return *destinations;
+	}
+
+	// Generates the valid destinations of a position when it is viewed without them
+	void cacheDestinations(size_t index, Position &position) {
+		if (!m_overlays) {
+			return;
+		}
+
+		const VariationTree::NodeId node = m_nodes[index];
+		if (m_tree.node(node).destinations) {
+			useDestinations(node);
+			return;
+		}
+
+		moves::Moves moves;
+		generateValidMoves(position, moves);
+		ValidDestinations &destinations = useDestinations(node);
+		destinations.assign(moves);
+		assignAttacks(destinations, position);
+	}
+
+	// Attacks only change with the position, they are worked out once per ply like the destinations
+	static void assignAttacks(ValidDestinations &destinations, const Position &position) {
+		using namespace common;
+
+		for (PieceColor color = PieceColor::WHITE; color != PieceColor::INVALID; ++color) {
+			destinations.attacked[color.get_raw_value()] = Bitboard(AttackMaps::attacked(position, color));
+			destinations.pinned[color.get_raw_value()] = Bitboard(AttackMaps::pinned(position, color));
+		}
+		destinations.checkers = Bitboard(AttackMaps::checkers(position, position.colorToMove()));
+	}
+
+	// Destinations and attacks of the viewed ply, nothing without overlays or once the cache let them go
+	const ValidDestinations *viewedDestinations() const {
+		if (!m_overlays || m_current >= m_nodes.size()) {
+			return nullptr;
+		}
+		return m_tree.node(m_nodes[m_current]).destinations.get();
+	}
+
+	// Rebuild the state of a ply by replaying deltas from the nearest keyframe
+	void materialize(size_t index, Detail &detail) {
+		const auto keyframe = std::prev(std::upper_bound(m_keyframes.begin(), m_keyframes.end(), index, [](size_t ply, const Keyframe &keyframe) {
+			return ply < keyframe.ply;
+		}));
+
+		detail.position = keyframe->position;
+		detail.move = m_deltas[keyframe->ply].move;
+		detail.maps = keyframe->maps;
+		if (keyframe->ply == index) {
+			return;
+		}
+
+		m_replay.setPosition(keyframe->position);
+		for (size_t ply = keyframe->ply + 1; ply <= index; ++ply) {
+			const Delta &delta = m_deltas[ply];
+			if (delta.move == moves::Move::EMPTY) {
+				PackedPosition::placeWalls(detail.position, delta.wall);
+				m_replay.setPosition(detail.position);
+			} else {
+				const moves::Result &result = m_replay.makeMove(delta.move);
+				detail.position = m_replay.position();
+				detail.update_maps(result);
+			}
+			detail.move = delta.move;
+		}
+	}
+
+	PieceAndSquareOffset calculateOffsets(const Detail &fromDetail, const Detail &toDetail) const {
+		using namespace common;
+
+		PieceAndSquareOffset result;
+
+		Bitboard movedIds(Maps::movedIds(fromDetail.maps, toDetail.maps));
+		while (movedIds != 0) {
+			const uint8_t id = movedIds.fastBitScan();
+			movedIds = movedIds.popLsb();
+
+			result.pieces[toDetail.maps.square(id)] = fromDetail.maps.square(id);
+		}
+
+		const uint64_t fromWalls = fromDetail.position.walls().get_raw_value();
+		const uint64_t toWalls = toDetail.position.walls().get_raw_value();
+		std::array<uint8_t, 64> origin;
+		if (fromWalls != toWalls && WallSlides::origins(fromWalls, toWalls, origin)) {
+			addSlideOffsets(origin, toWalls, 0, result);
+		}
+
 		return result;
 	}
 
-	void computeValidMoves() {
+	// Squares pushed aside by the walls come from their origin, pieces on the occupied ones move with them
+	static void addSlideOffsets(const std::array<uint8_t, 64> &origin, uint64_t walls, uint64_t occupancy, PieceAndSquareOffset &offsets) {
+		for (size_t square = 0; square < origin.size(); ++square) {
+			if (origin[square] == square || (walls & (uint64_t(1) << square)) != 0) {
+				continue;
+			}
+
+			offsets.squares[square] = common::Square(static_cast<size_t>(origin[square]));
+			if ((occupancy & (uint64_t(1) << square)) != 0) {
+				offsets.pieces[square] = common::Square(static_cast<size_t>(origin[square]));
+			}
+		}
+	}
+
+	// Positions generated by any board are served from the shared cache, views without overlays generate their own
+	void generateValidMoves(const Position &position, moves::Moves &moves) const {
+		if (!m_overlays) {
+			PositionMoves::getValidMoves(position, moves);
+			return;
+		}
+
+		MoveCache &cache = MoveCache::shared();
+		if (!cache.find(position, moves)) {
+			PositionMoves::getValidMoves(position, moves);
+			cache.store(position, moves);
+		}
+	}
+
+	size_t tipColor() const {
+		return m_tip.position.colorToMove().get_raw_value();
+	}
+
+	void addValidMove(size_t color, moves::Move move) {
+		SquareMoves &squareMoves = m_validMovesMap[color][move.from()];
+
+		// Promotions share squares, keep the first so the lookup can scan the rest
+		uint8_t &index = m_moveIndex[color][move.from()][move.to()];
+		if (index == NO_MOVE_INDEX) {
+			index = static_cast<uint8_t>(squareMoves.size());
+		}
+		squareMoves.push_back(move);
+	}
+
+	void clearValidMoves(size_t color, size_t square) {
+		SquareMoves &squareMoves = m_validMovesMap[color][square];
+		for (size_t i = 0; i < squareMoves.size(); ++i) {
+			m_moveIndex[color][square][squareMoves[i].to()] = NO_MOVE_INDEX;
+		}
+		squareMoves.clear();
+	}
+
+	// Moves generated for plies that are no longer part of the line can not be updated
+	void forgetGeneratedAfter(size_t ply) {
+		for (Generated &generated : m_generated) {
+			if (generated.ply != NO_PLY && generated.ply > ply) {
+				generated = Generated();
+			}
+		}
+	}
+
+	// Flattens the moves of the side to move once its squares are up to date
+	void finishValidMoves(size_t color) {
 		m_validMoves.clear();
-		for (size_t i = 0; i < m_validMovesMap.size(); ++i) {
-			m_validMovesMap[i].clear();
+		for (size_t square = 0; square < m_validMovesMap[color].size(); ++square) {
+			for (size_t i = 0; i < m_validMovesMap[color][square].size(); ++i) {
+				m_validMoves.push_back(m_validMovesMap[color][square][i]);
+			}
+		}
+
+		m_generated[color].ply = m_deltas.size() - 1;
+		m_generated[color].position = m_tip.position;
+		if (!m_overlays) {
+			return;
+		}
+
+		// The latest ply always has its destinations cached
+		ValidDestinations &destinations = useDestinations(m_nodes.back());
+		destinations.assign(m_validMoves);
+		assignAttacks(destinations, m_tip.position);
+	}
+
+	void computeValidMoves() {
+		const size_t color = tipColor();
+		for (size_t square = 0; square < m_validMovesMap[color].size(); ++square) {
+			clearValidMoves(color, square);
+		}
+
+		moves::Moves moves;
+		generateValidMoves(m_session.position(), moves);
+		for (size_t i = 0; i < moves.size(); ++i) {
+			addValidMove(color, moves[i]);
+		}
+
+		finishValidMoves(color);
+	}
+
+	// Updates the moves the side to move had two plies ago instead of generating them again
+	// Only pieces whose moves could have changed are generated, every piece while in check or just out of it
+	// Positions involving en passant, promotions, castling squares or the walls are left to the full generator
+	bool updateValidMoves() {
+		using namespace common;
+		using namespace moves;
+
+		const Position &position = m_tip.position;
+		const PieceColor color = position.colorToMove();
+		const PieceColor enemy = color.invert();
+		const size_t side = color.get_raw_value();
+		const size_t tip = m_deltas.size() - 1;
+
+		if (tip < 2 || m_generated[side].ply != tip - 2) {
+			return false;
+		}
+
+		const Position &previous = m_generated[side].position;
+		for (size_t ply = tip - 1; ply <= tip; ++ply) {
+			if (m_deltas[ply].move == Move::EMPTY || m_deltas[ply].slide() != FieldIndex::ZERO) {
+				return false;
+			}
+		}
+
+		if (position.walls() != previous.walls()) {
+			return false;
+		}
+
+		const uint64_t kings = position.colorPieceMask(color, PieceType::KING).get_raw_value();
+		if (kings == 0) {
+			return false;
+		}
+
+		// A double push by the opponent allows en passant
+		const Move lastMove = m_deltas[tip].move;
+		if ((position.colorPieceMask(enemy, PieceType::PAWN).get_raw_value() & lastMove.to().asBitboard().get_raw_value()) != 0 &&
+				std::abs(lastMove.to().asFieldIndex().y - lastMove.from().asFieldIndex().y) == 2) {
+			return false;
+		}
+
+		uint64_t changed = 0;
+		for (PieceColor pieceColor = PieceColor::WHITE; pieceColor != PieceColor::INVALID; ++pieceColor) {
+			for (PieceType type = PieceType::PAWN; type != PieceType::INVALID; ++type) {
+				changed |= (position.colorPieceMask(pieceColor, type) ^ previous.colorPieceMask(pieceColor, type)).get_raw_value();
+			}
+		}
+
+		// Moves near the walls can slide them, only the full generator knows those
+		const uint64_t walls = position.walls().get_raw_value();
+		uint64_t wallArea = walls;
+		for (uint64_t wall = walls; wall != 0; wall &= wall - 1) {
+			wallArea |= AttackMaps::king(AttackMaps::lowest(wall));
+		}
+		if ((changed & wallArea) != 0) {
+			return false;
+		}
+
+		// Other pieces have to capture a single checker or block it, against a double check only the king moves
+		const size_t king = AttackMaps::lowest(kings);
+		const uint64_t checkers = AttackMaps::checkers(position, color);
+		const bool checked = checkers != 0 || AttackMaps::checkers(previous, color) != 0;
+		uint64_t evasions = ~uint64_t(0);
+		if (checkers != 0) {
+			evasions = (checkers & (checkers - 1)) != 0 ? 0 : checkers | AttackMaps::between(king, AttackMaps::lowest(checkers));
+		}
+
+		const uint64_t occupancy = position.occupancySummary().get_raw_value();
+		const uint64_t previousOccupancy = previous.occupancySummary().get_raw_value();
+		const uint64_t own = AttackMaps::occupancy(position, color);
+		const uint64_t opponent = AttackMaps::occupancy(position, enemy);
+		const uint64_t attacked = AttackMaps::attacked(position, enemy, occupancy & ~kings);
+
+		// Castling depends on the squares between the king and rooks and whether they are attacked, a king in check can not castle
+		const uint64_t backRank = AttackMaps::rank(color == PieceColor::WHITE ? 0 : 7);
+		if ((kings & backRank) != 0 && checkers == 0) {
+			const uint64_t previousKings = previous.colorPieceMask(color, PieceType::KING).get_raw_value();
+			const uint64_t previousAttacked = AttackMaps::attacked(previous, enemy, previousOccupancy & ~previousKings);
+			if ((changed & backRank) != 0 || ((attacked ^ previousAttacked) & backRank) != 0) {
+				return false;
+			}
+		}
+
+		// Captures onto empty squares are en passant and expire after one ply
+		for (uint64_t pawns = previous.colorPieceMask(color, PieceType::PAWN).get_raw_value(); pawns != 0; pawns &= pawns - 1) {
+			const size_t pawn = AttackMaps::lowest(pawns);
+			const SquareMoves &pawnMoves = m_validMovesMap[side][pawn];
+			for (size_t i = 0; i < pawnMoves.size(); ++i) {
+				const uint64_t to = pawnMoves[i].to().asBitboard().get_raw_value();
+				if ((AttackMaps::pawn(pawn, color) & to) != 0 && (previousOccupancy & to) == 0) {
+					return false;
+				}
+			}
+		}
+
+		std::array<uint64_t, 64> pinRays;
+		const uint64_t pinned = AttackMaps::pinned(position, color, &pinRays);
+
+		// Pieces that moved, lost or gained a pin, or see a changed square have to be generated again
+		// A check that was given or answered changes the moves of every piece
+		uint64_t affected = checked ? own : (own & changed) | pinned | AttackMaps::pinned(previous, color) | kings;
+		for (PieceType type = PieceType::PAWN; type != PieceType::INVALID; ++type) {
+			for (uint64_t pieces = position.colorPieceMask(color, type).get_raw_value() & ~affected; pieces != 0; pieces &= pieces - 1) {
+				const size_t square = AttackMaps::lowest(pieces);
+				uint64_t reach = AttackMaps::attacks(square, type, color, occupancy) | AttackMaps::attacks(square, type, color, previousOccupancy);
+				if (type == PieceType::PAWN) {
+					reach |= AttackMaps::pawnPushes(square, color);
+				}
+				if ((reach & changed) != 0) {
+					affected |= uint64_t(1) << square;
+				}
+			}
+		}
+		affected &= own;
+
+		// Check every affected piece can be generated here before touching the moves
+		const uint64_t promotionRank = AttackMaps::rank(color == PieceColor::WHITE ? 6 : 1);
+		const uint64_t pawns = position.colorPieceMask(color, PieceType::PAWN).get_raw_value();
+		for (uint64_t pieces = affected; pieces != 0; pieces &= pieces - 1) {
+			const size_t square = AttackMaps::lowest(pieces);
+			const uint64_t bit = uint64_t(1) << square;
+			const std::optional<std::tuple<PieceColor, PieceType>> piece = position.getPiece(Square(square));
+			if (!piece) {
+				return false;
+			}
+
+			uint64_t reach = AttackMaps::attacks(square, std::get<1>(*piece), color, occupancy);
+			if ((pawns & bit) != 0) {
+				if ((promotionRank & bit) != 0) {
+					return false;
+				}
+				reach |= AttackMaps::pawnPushes(square, color);
+			}
+			if ((reach & walls) != 0) {
+				return false;
+			}
+		}
+
+		// Remove the moves of squares that lost or changed their piece, then generate the affected pieces
+		for (uint64_t squares = affected | (AttackMaps::occupancy(previous, color) & changed); squares != 0; squares &= squares - 1) {
+			const size_t square = AttackMaps::lowest(squares);
+			const SquareMoves previousMoves = m_validMovesMap[side][square];
+			clearValidMoves(side, square);
+
+			const uint64_t bit = uint64_t(1) << square;
+			if ((affected & bit) == 0) {
+				continue;
+			}
+
+			const PieceType type = std::get<1>(*position.getPiece(Square(square)));
+			const uint64_t allowed = ((pinned & bit) != 0 ? pinRays[square] : ~uint64_t(0)) & (type == PieceType::KING ? ~uint64_t(0) : evasions);
+			uint64_t targets = 0;
+			if (type == PieceType::PAWN) {
+				const uint64_t pushes = AttackMaps::pawnPushes(square, color);
+				const uint64_t single = pushes & AttackMaps::king(square);
+				if ((occupancy & single) == 0) {
+					targets |= single & allowed;
+
+					// Double pushes carry their own flags, reuse the generated one
+					const uint64_t twice = (pushes & ~single) & ~occupancy & allowed;
+					if (twice != 0) {
+						bool found = false;
+						for (size_t i = 0; i < previousMoves.size(); ++i) {
+							if (previousMoves[i].to().asBitboard().get_raw_value() == twice) {
+								addValidMove(side, previousMoves[i]);
+								found = true;
+							}
+						}
+						if (!found) {
+							return false;
+						}
+					}
+				}
+				targets |= AttackMaps::pawn(square, color) & opponent & allowed;
+			} else {
+				targets = AttackMaps::attacks(square, type, color, occupancy) & ~own & allowed;
+				if (type == PieceType::KING) {
+					targets &= ~attacked;
+
+					// The squares castling needs are unchanged so its moves are too
+					for (size_t i = 0; checkers == 0 && i < previousMoves.size(); ++i) {
+						if (previousMoves[i].flags() == MoveFlags::KING_CASTLE || previousMoves[i].flags() == MoveFlags::QUEEN_CASTLE) {
+							addValidMove(side, previousMoves[i]);
+						}
+					}
+				}
+			}
+
+			for (; targets != 0; targets &= targets - 1) {
+				const size_t target = AttackMaps::lowest(targets);
+				const MoveFlags flags = (opponent & (uint64_t(1) << target)) != 0 ? MoveFlags::CAPTURE : MoveFlags::QUIET;
+				addValidMove(side, Move(Square(square), Square(target), flags));
+			}
+		}
+
+		// Any difference to the full generator falls back to it
+		if (checkUpdatedMoves().load(std::memory_order_relaxed)) {
+			moves::Moves expected;
+			PositionMoves::getValidMoves(position, expected);
+			size_t count = 0;
+			for (size_t square = 0; square < m_validMovesMap[side].size(); ++square) {
+				count += m_validMovesMap[side][square].size();
+			}
+			bool matches = count == expected.size();
+			for (size_t i = 0; matches && i < expected.size(); ++i) {
+				const SquareMoves &squareMoves = m_validMovesMap[side][expected[i].from()];
+				matches = false;
+				for (size_t j = 0; !matches && j < squareMoves.size(); ++j) {
+					matches = squareMoves[j] == expected[i];
+				}
+			}
+			if (!matches) {
+				mismatchedUpdates().fetch_add(1, std::memory_order_relaxed);
+				EngineLog::warn("Incremental move generation differs from the full generator, regenerating");
+				return false;
+			}
 		}
 
-		phase4::engine::board::PositionMoves::getValidMoves(m_session.position(), m_validMoves);
-		for (size_t i = 0; i < m_validMoves.size(); ++i) {
-			m_validMovesMap[m_validMoves[i].from()].push_back(m_validMoves[i]);
+		finishValidMoves(side);
+		if (m_overlays) {
+			MoveCache::shared().store(position, m_validMoves);
 		}
+		return true;
+	}
+
+	static std::atomic<bool> &checkUpdatedMoves() {
+#ifdef DEBUG_ENABLED
+		static std::atomic<bool> check{ true };
+#else
+		static std::atomic<bool> check{ false };
+#endif
+		return check;
+	}
+
+	static std::atomic<uint64_t> &mismatchedUpdates() {
+		static std::atomic<uint64_t> mismatches{ 0 };
+		return mismatches;
 	}
 
 	Session m_session;
-	moves::Moves m_validMoves;
-	std::array<common::FastVector<moves::Move, 21>, 64> m_validMovesMap;
+	size_t m_sessionBase; // Ply the session was last positioned at
+	Session m_replay; // Scratch session used to rebuild plies between keyframes
+
+	static constexpr uint8_t NO_MOVE_INDEX = 0xFF;
+	static constexpr size_t NO_PLY = SIZE_MAX;
+
+	// Position each side last had its moves generated for, the next position of that side updates them
+	struct Generated {
+		size_t ply = NO_PLY;
+		Position position;
+	};
+
+	moves::Moves m_validMoves; // Moves of the latest state
+	std::array<std::array<SquareMoves, 64>, 2> m_validMovesMap; // Moves by color and square
+	std::array<MoveIndex, 2> m_moveIndex = { emptyMoveIndex(), emptyMoveIndex() }; // Index into m_validMovesMap by color, from and to squares
+	std::array<Generated, 2> m_generated;
 
 	size_t m_current;
-	phase4::engine::common::FastVector<Detail> m_details;
+	Detail m_tip; // State after the last ply
+	Detail m_view; // State of the viewed ply
+
+	std::vector<Delta> m_deltas; // One per ply, the first is the starting position
+	std::vector<VariationTree::NodeId> m_nodes; // Node of each ply of the current line
+	VariationTree m_tree; // Every position explored since the last reset
+	std::vector<VariationTree::NodeId> m_cachedNodes; // Nodes holding destinations, least recently used first
+	std::vector<Keyframe> m_keyframes; // Sorted by ply
+
+	// Hash of the latest plies by ply modulo REPETITION_PLIES, with the times it occurred up to that ply
+	struct PlyHash {
+		uint64_t hash = 0;
+		uint32_t repetitions = 0;
+	};
+	std::array<PlyHash, REPETITION_PLIES> m_plyHashes;
+	size_t m_recordedPlies = 0; // Plies recorded into the window, the next one to record
+
+	// Times every hash occurs within the window, open addressed and never more than half full
+	static constexpr size_t WINDOW_SLOTS = 2 * REPETITION_PLIES;
+	struct WindowCount {
+		uint64_t hash = 0;
+		uint32_t count = 0; // 0 for an empty slot
+	};
+	std::array<WindowCount, WINDOW_SLOTS> m_windowCounts;
+
+	// Ply removed by undo, kept whole so redo does not have to replay or regenerate it
+	struct Redo {
+		Delta delta;
+		VariationTree::NodeId node;
+		Detail detail;
+		std::optional<Keyframe> keyframe;
+		moves::Moves validMoves;
+		AlgebraicNotation notation;
+	};
+	std::vector<Redo> m_redo; // Last undone ply at the back
+
+	std::vector<AlgebraicNotation> m_notations; // One per ply, empty until requested
+	std::optional<Position> m_tipParent; // Position before the latest ply when it was made by makeMove
+
+	MoveJournal *m_journal = nullptr; // Receives every change to the game when attached
+	RecordSink *m_sink = nullptr;
+	bool m_overlays = true; // Whether destinations and attacks are kept and moves shared through MoveCache
 };
 
 } //namespace phase4::engine::board
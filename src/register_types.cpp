@@ -1,12 +1,20 @@
 #include "register_types.h"
 
 #include "chess2d.h"
+#include "chess_engine.h"
+#include "chess_game.h"
 #include "chess_theme.h"
+#include "engine_log.h"
+#include "game_replicator.h"
+#include "position_book.h"
+#include "position_store.h"
 #include "slide_puzzle.h"
+#include "tournament.h"
 
 #include <gdextension_interface.h>
 #include <godot_cpp/core/class_db.hpp>
 #include <godot_cpp/core/defs.hpp>
+#include <godot_cpp/core/error_macros.hpp>
 #include <godot_cpp/godot.hpp>
 
 using namespace godot;
@@ -16,8 +24,18 @@ void initialize_gdextension_types(ModuleInitializationLevel p_level) {
 		return;
 	}
 
+	phase4::engine::board::EngineLog::setHandler([](const char *message) {
+		WARN_PRINT(message);
+	});
+
 	ClassDB::register_class<ChessTheme>();
+	ClassDB::register_class<PositionStore>();
+	ClassDB::register_class<PositionBook>();
 	ClassDB::register_class<Chess2D>();
+	ClassDB::register_class<ChessGame>();
+	ClassDB::register_class<ChessEngine>();
+	ClassDB::register_class<Tournament>();
+	ClassDB::register_class<GameReplicator>();
 	ClassDB::register_class<SlidePuzzle>();
 }
 
@@ -25,6 +43,8 @@ void uninitialize_gdextension_types(ModuleInitializationLevel p_level) {
 	if (p_level != MODULE_INITIALIZATION_LEVEL_SCENE) {
 		return;
 	}
+
+	phase4::engine::board::EngineLog::setHandler(nullptr);
 }
 
 extern "C" {
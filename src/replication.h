@@ -0,0 +1,259 @@
+#ifndef PHASE4_ENGINE_BOARD_REPLICATION_H
+#define PHASE4_ENGINE_BOARD_REPLICATION_H
+
+#include "move_journal.h"
+#include "position_view.h"
+
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <vector>
+
+namespace phase4::engine::board {
+
+// Wire format for following a game from another process
+//
+// Each change is a frame of a header byte, its operands and the low 16 bits of the hash of the viewed position
+// after it, so a follower that drifted notices on the ply it happened and asks for a snapshot
+//
+// The header holds the frame type in its low 3 bits, the rest is used by the type
+//   MOVE      2 bytes: from | to << 6 | flags << 12
+//   WALLS     1 byte square
+//   SLIDE     bit 3 of the header when added to the history, 1 byte with direction x and y as 4 bit signed values
+//   UNDO      nothing
+//   REDO      nothing
+//   SEEK      ply as a varint
+//   SNAPSHOT  size as a varint, a 4 byte checksum of the snapshot bytes, then a PositionView snapshot, no hash
+//   RESYNC    sent back by a follower that drifted, no checksum
+class Replication {
+public:
+	static constexpr uint8_t RESYNC = 0;
+	static constexpr uint8_t SNAPSHOT = 7; // Records use their journal type for the rest
+	static constexpr size_t MAX_SNAPSHOT_SIZE = 64 * 1024 * 1024;
+
+	struct Frame {
+		uint8_t type = RESYNC;
+		MoveJournal::Record record;
+		uint16_t checksum = 0;
+		std::vector<uint8_t> snapshot;
+	};
+
+	static uint16_t checksum(uint64_t hash) {
+		return static_cast<uint16_t>(hash);
+	}
+
+	static uint32_t snapshotChecksum(const uint8_t *data, size_t size) {
+		return MoveJournal::checksum(data, size, 0);
+	}
+};
+
+// Turns the changes of a game into frames, attach it with PositionView::setRecordSink
+class ReplicationEncoder : public RecordSink {
+public:
+	void record(const MoveJournal::Record &record, uint64_t hash) override {
+		const auto &operands = record.operands;
+		switch (record.type) {
+			case MoveJournal::MOVE: {
+				const uint16_t code = static_cast<uint16_t>(operands[0] | (operands[1] << 6) | (operands[2] << 12));
+				m_output.push_back(record.type);
+				m_output.push_back(static_cast<uint8_t>(code));
+				m_output.push_back(static_cast<uint8_t>(code >> 8));
+				break;
+			}
+			case MoveJournal::WALLS:
+				m_output.push_back(record.type);
+				m_output.push_back(operands[0]);
+				break;
+			case MoveJournal::SLIDE:
+				m_output.push_back(static_cast<uint8_t>(record.type | (operands[2] ? 8 : 0)));
+				m_output.push_back(static_cast<uint8_t>((operands[0] & 0x0F) | (operands[1] << 4)));
+				break;
+			case MoveJournal::SEEK:
+				m_output.push_back(record.type);
+				writeVarint(operands[0] | (operands[1] << 8) | (operands[2] << 16));
+				break;
+			default:
+				m_output.push_back(record.type);
+				break;
+		}
+
+		const uint16_t sum = Replication::checksum(hash);
+		m_output.push_back(static_cast<uint8_t>(sum));
+		m_output.push_back(static_cast<uint8_t>(sum >> 8));
+	}
+
+	void replaced(const PositionView &view) override {
+		writeSnapshot(view);
+	}
+
+	// Sends the whole game, answers a resync and starts a follower
+	void writeSnapshot(const PositionView &view) {
+		const size_t size = view.snapshotSize();
+		m_output.push_back(Replication::SNAPSHOT);
+		writeVarint(size);
+
+		const size_t offset = m_output.size() + sizeof(uint32_t);
+		m_output.resize(offset + size);
+		view.writeSnapshot(m_output.data() + offset);
+		const uint32_t sum = Replication::snapshotChecksum(m_output.data() + offset, size);
+		std::memcpy(m_output.data() + offset - sizeof(sum), &sum, sizeof(sum));
+	}
+
+	void writeResync() {
+		m_output.push_back(Replication::RESYNC);
+	}
+
+	// Bytes waiting to be sent, the caller removes what it sent
+	std::vector<uint8_t> &output() {
+		return m_output;
+	}
+
+private:
+	void writeVarint(size_t value) {
+		do {
+			const uint8_t low = value & 0x7F;
+			value >>= 7;
+			m_output.push_back(static_cast<uint8_t>(low | (value != 0 ? 0x80 : 0)));
+		} while (value != 0);
+	}
+
+	std::vector<uint8_t> m_output;
+};
+
+// Splits received bytes into frames, bytes may arrive in pieces of any size
+class ReplicationDecoder {
+public:
+	void feed(const uint8_t *data, size_t size) {
+		// Drop what was read before growing so the buffer stays the size of one frame
+		if (m_read > 0 && m_read >= m_input.size() / 2) {
+			m_input.erase(m_input.begin(), m_input.begin() + m_read);
+			m_read = 0;
+		}
+		m_input.insert(m_input.end(), data, data + size);
+	}
+
+	// The next complete frame, nothing until more bytes arrive or when the stream is not valid
+	// A snapshot that does not match its checksum arrives empty, which no view restores
+	std::optional<Replication::Frame> next() {
+		if (m_failed) {
+			return {};
+		}
+
+		size_t offset = m_read;
+		uint8_t header;
+		if (!readByte(offset, header)) {
+			return {};
+		}
+
+		Replication::Frame frame;
+		frame.type = header & 7;
+		auto &operands = frame.record.operands;
+		frame.record.type = frame.type;
+		switch (frame.type) {
+			case Replication::RESYNC:
+				m_read = offset;
+				return frame;
+			case Replication::SNAPSHOT: {
+				size_t size;
+				if (!readVarint(offset, size)) {
+					return {};
+				}
+				if (size > Replication::MAX_SNAPSHOT_SIZE) {
+					m_failed = true;
+					return {};
+				}
+				if (m_input.size() - offset < sizeof(uint32_t) + size) {
+					return {};
+				}
+
+				uint32_t sum;
+				std::memcpy(&sum, m_input.data() + offset, sizeof(sum));
+				offset += sizeof(sum);
+				if (sum == Replication::snapshotChecksum(m_input.data() + offset, size)) {
+					frame.snapshot.assign(m_input.begin() + offset, m_input.begin() + offset + size);
+				}
+				m_read = offset + size;
+				return frame;
+			}
+			case MoveJournal::MOVE: {
+				uint8_t low, high;
+				if (!readByte(offset, low) || !readByte(offset, high)) {
+					return {};
+				}
+				const uint16_t code = static_cast<uint16_t>(low | (high << 8));
+				operands = { static_cast<uint8_t>(code & 63), static_cast<uint8_t>((code >> 6) & 63), static_cast<uint8_t>(code >> 12) };
+				break;
+			}
+			case MoveJournal::WALLS:
+				if (!readByte(offset, operands[0])) {
+					return {};
+				}
+				break;
+			case MoveJournal::SLIDE: {
+				uint8_t direction;
+				if (!readByte(offset, direction)) {
+					return {};
+				}
+				// Sign extend the 4 bit values
+				operands = { static_cast<uint8_t>(static_cast<int8_t>(direction << 4) >> 4), static_cast<uint8_t>(static_cast<int8_t>(direction) >> 4), static_cast<uint8_t>((header >> 3) & 1) };
+				break;
+			}
+			case MoveJournal::SEEK: {
+				size_t ply;
+				if (!readVarint(offset, ply)) {
+					return {};
+				}
+				operands = { static_cast<uint8_t>(ply), static_cast<uint8_t>(ply >> 8), static_cast<uint8_t>(ply >> 16) };
+				break;
+			}
+			default:
+				break;
+		}
+
+		uint8_t low, high;
+		if (!readByte(offset, low) || !readByte(offset, high)) {
+			return {};
+		}
+		frame.checksum = static_cast<uint16_t>(low | (high << 8));
+		m_read = offset;
+		return frame;
+	}
+
+	// A frame that could not be read, nothing more is read from the stream
+	bool failed() const {
+		return m_failed;
+	}
+
+private:
+	bool readByte(size_t &offset, uint8_t &value) const {
+		if (offset >= m_input.size()) {
+			return false;
+		}
+		value = m_input[offset++];
+		return true;
+	}
+
+	bool readVarint(size_t &offset, size_t &value) {
+		value = 0;
+		for (size_t shift = 0; shift < 64; shift += 7) {
+			uint8_t byte;
+			if (!readByte(offset, byte)) {
+				return false;
+			}
+			value |= size_t(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0) {
+				return true;
+			}
+		}
+		m_failed = true;
+		return false;
+	}
+
+	std::vector<uint8_t> m_input;
+	size_t m_read = 0; // Start of the first frame not returned yet
+	bool m_failed = false;
+};
+
+} //namespace phase4::engine::board
+
+#endif
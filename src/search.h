@@ -0,0 +1,334 @@
+#ifndef PHASE4_ENGINE_BOARD_SEARCH_H
+#define PHASE4_ENGINE_BOARD_SEARCH_H
+
+#include "position_key.h"
+#include "tablebase.h"
+#include "transposition_table.h"
+
+#include <phase4/engine/board/position.h>
+#include <phase4/engine/board/position_moves.h>
+#include <phase4/engine/board/session.h>
+#include <phase4/engine/common/piece_color.h>
+#include <phase4/engine/common/piece_type.h>
+#include <phase4/engine/moves/move.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+namespace phase4::engine::board {
+
+// Iterative deepening alpha-beta over the engine's move generation
+// Moves are made and taken back through a Session so slides caused by moves are searched like any other move
+class Search {
+public:
+	static constexpr int32_t MATE = 30000;
+	static constexpr int32_t INFINITE = 32000;
+	static constexpr size_t MAX_PLY = 64;
+	static constexpr int32_t TABLEBASE_WIN = MATE - 2 * int32_t(MAX_PLY); // Wins of WDL tables, below any mate the search finds
+
+	struct Limits {
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+		int32_t maxDepth = MAX_PLY - 1;
+		const std::atomic<bool> *cancelled = nullptr;
+	};
+
+	struct Result {
+		std::optional<moves::Move> move; // Nothing when the position has no valid moves
+		int32_t score = 0; // Centipawns for the side to move, mates are near MATE and wins of WDL tables near TABLEBASE_WIN
+		int32_t depth = 0; // Deepest iteration that completed
+		uint64_t nodes = 0;
+	};
+
+	explicit Search(TranspositionTable &table) :
+			m_table(table) {
+	}
+
+	// Positions the tablebase knows are scored from it instead of searched, nothing to search everything
+	void setTablebase(const Tablebase *tablebase) {
+		m_tablebase = tablebase;
+	}
+
+	static uint16_t encode(moves::Move move) {
+		return static_cast<uint16_t>(move.from().get_raw_value() | (move.to().get_raw_value() << 6) | (move.flags().get_raw_value() << 12));
+	}
+
+	// Material for the side to move
+	static int32_t evaluate(const Position &position) {
+		using namespace common;
+
+		int32_t score = 0;
+		for (PieceType type = PieceType::PAWN; type != PieceType::INVALID; ++type) {
+			const int32_t value = VALUES[type.get_raw_value()];
+			score += value * count(position.colorPieceMask(PieceColor::WHITE, type).get_raw_value());
+			score -= value * count(position.colorPieceMask(PieceColor::BLACK, type).get_raw_value());
+		}
+		return position.colorToMove() == PieceColor::WHITE ? score : -score;
+	}
+
+	// Searches deeper until the limits are reached, the move of an interrupted iteration is only taken before any depth completed
+	// Its score is a bound on the moves it got to, a better one there does not make its move better than the last complete one
+	Result run(const Position &position, const Limits &limits) {
+		m_limits = limits;
+		m_stopped = false;
+		m_nodes = 0;
+		m_killers.fill({ 0, 0 });
+		m_session.setPosition(position);
+
+		Result result;
+		moves::Moves rootMoves;
+		PositionMoves::getValidMoves(position, rootMoves);
+		if (rootMoves.size() == 0) {
+			result.score = position.isKingChecked(position.colorToMove()) ? -MATE : 0;
+			return result;
+		}
+		result.move = rootMoves[0];
+
+		for (int32_t depth = 1; depth <= std::min<int32_t>(limits.maxDepth, MAX_PLY - 1) && !limitReached(); ++depth) {
+			const int32_t score = alphaBeta(depth, 0, -INFINITE, INFINITE);
+
+			TranspositionTable::Entry entry;
+			if (m_table.probe(PositionKey::of(position), entry) && entry.move != 0 && (!m_stopped || result.depth == 0)) {
+				for (size_t i = 0; i < rootMoves.size(); ++i) {
+					if (encode(rootMoves[i]) == entry.move) {
+						result.move = rootMoves[i];
+						break;
+					}
+				}
+			}
+
+			if (m_stopped) {
+				break;
+			}
+
+			result.score = score;
+			result.depth = depth;
+			if (std::abs(score) >= MATE - int32_t(MAX_PLY)) {
+				break; // A forced mate will not get shorter by searching deeper
+			}
+		}
+
+		result.nodes = m_nodes;
+		return result;
+	}
+
+private:
+	static constexpr std::array<int32_t, 6> VALUES = { 100, 320, 330, 500, 900, 0 }; // By piece type
+	static constexpr uint64_t CHECK_INTERVAL = 1024; // Nodes between looking at the clock
+
+	static int32_t count(uint64_t bitboard) {
+		return static_cast<int32_t>(std::bitset<64>(bitboard).count());
+	}
+
+	bool limitReached() const {
+		return std::chrono::steady_clock::now() >= m_limits.deadline || (m_limits.cancelled && m_limits.cancelled->load(std::memory_order_relaxed));
+	}
+
+	bool shouldStop() {
+		if ((++m_nodes % CHECK_INTERVAL) == 0 && limitReached()) {
+			m_stopped = true;
+		}
+		return m_stopped;
+	}
+
+	// Value of the piece on the square the move goes to, 0 when it takes nothing
+	static int32_t victim(const Position &position, moves::Move move) {
+		using namespace common;
+
+		const PieceColor enemy = position.colorToMove().invert();
+		const uint64_t to = move.to().asBitboard().get_raw_value();
+		for (PieceType type = PieceType::PAWN; type != PieceType::INVALID; ++type) {
+			if ((position.colorPieceMask(enemy, type).get_raw_value() & to) != 0) {
+				return VALUES[type.get_raw_value()];
+			}
+		}
+		return 0;
+	}
+
+	// The table move first, then captures of the most valuable pieces, then the killers of the ply
+	void orderMoves(moves::Moves &moves, uint16_t tableMove, size_t ply) {
+		const Position &position = m_session.position();
+
+		std::array<int32_t, 256> scores;
+		for (size_t i = 0; i < moves.size(); ++i) {
+			const uint16_t code = encode(moves[i]);
+			if (code == tableMove) {
+				scores[i] = 1 << 20;
+			} else if (const int32_t value = victim(position, moves[i])) {
+				scores[i] = (1 << 16) + value;
+			} else if (code == m_killers[ply][0] || code == m_killers[ply][1]) {
+				scores[i] = 1 << 12;
+			} else {
+				scores[i] = 0;
+			}
+		}
+
+		// Insertion sort, move lists are short and mostly ordered already
+		for (size_t i = 1; i < moves.size(); ++i) {
+			const moves::Move move = moves[i];
+			const int32_t score = scores[i];
+			size_t j = i;
+			for (; j > 0 && scores[j - 1] < score; --j) {
+				moves[j] = moves[j - 1];
+				scores[j] = scores[j - 1];
+			}
+			moves[j] = move;
+			scores[j] = score;
+		}
+	}
+
+	bool isRepetition(size_t ply) const {
+		const uint64_t hash = m_path[ply];
+		for (size_t i = ply % 2; i < ply; i += 2) {
+			if (m_path[i] == hash) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	int32_t alphaBeta(int32_t depth, size_t ply, int32_t alpha, int32_t beta) {
+		const Position &position = m_session.position();
+		const uint64_t key = PositionKey::of(position);
+		m_path[ply] = key;
+
+		if (ply > 0 && (shouldStop() || isRepetition(ply))) {
+			return 0;
+		}
+
+		if (ply > 0 && m_tablebase) {
+			if (const std::optional<Tablebase::Result> known = m_tablebase->probe(position)) {
+				if (!known->hasPlies) {
+					return known->wdl == Tablebase::WIN ? TABLEBASE_WIN - int32_t(ply) : known->wdl == Tablebase::LOSS ? -TABLEBASE_WIN + int32_t(ply) : 0;
+				}
+				const int32_t distance = int32_t(ply) + known->plies;
+				return known->wdl == Tablebase::WIN ? MATE - distance : known->wdl == Tablebase::LOSS ? -MATE + distance : 0;
+			}
+		}
+
+		if (depth <= 0 || ply >= MAX_PLY - 1) {
+			return quiescence(ply, alpha, beta);
+		}
+
+		const int32_t originalAlpha = alpha;
+		TranspositionTable::Entry entry;
+		const bool found = m_table.probe(key, entry);
+		if (found && ply > 0 && entry.depth >= depth) {
+			const int32_t score = fromTable(entry.score, ply);
+			if (entry.bound == TranspositionTable::EXACT ||
+					(entry.bound == TranspositionTable::LOWER && score >= beta) ||
+					(entry.bound == TranspositionTable::UPPER && score <= alpha)) {
+				return score;
+			}
+		}
+
+		moves::Moves &moves = m_moves[ply];
+		moves.clear();
+		PositionMoves::getValidMoves(position, moves);
+		if (moves.size() == 0) {
+			return position.isKingChecked(position.colorToMove()) ? -MATE + int32_t(ply) : 0;
+		}
+		orderMoves(moves, found ? entry.move : 0, ply);
+
+		int32_t best = -INFINITE;
+		uint16_t bestMove = 0;
+		for (size_t i = 0; i < moves.size(); ++i) {
+			const moves::Move move = moves[i];
+			const bool quiet = victim(m_session.position(), move) == 0;
+
+			m_session.makeMove(move);
+			const int32_t score = -alphaBeta(depth - 1, ply + 1, -beta, -alpha);
+			m_session.undoMove(move);
+
+			if (m_stopped) {
+				return best == -INFINITE ? 0 : best;
+			}
+
+			if (score > best) {
+				best = score;
+				bestMove = encode(move);
+			}
+			if (score > alpha) {
+				alpha = score;
+			}
+			if (alpha >= beta) {
+				if (quiet && m_killers[ply][0] != bestMove) {
+					m_killers[ply][1] = m_killers[ply][0];
+					m_killers[ply][0] = bestMove;
+				}
+				break;
+			}
+		}
+
+		TranspositionTable::Entry stored;
+		stored.move = bestMove;
+		stored.score = static_cast<int16_t>(toTable(best, ply));
+		stored.depth = static_cast<uint8_t>(depth);
+		stored.bound = best <= originalAlpha ? TranspositionTable::UPPER : best >= beta ? TranspositionTable::LOWER : TranspositionTable::EXACT;
+		m_table.store(key, stored);
+		return best;
+	}
+
+	// Captures only until the position is quiet, so the search does not stop in the middle of an exchange
+	int32_t quiescence(size_t ply, int32_t alpha, int32_t beta) {
+		if (shouldStop()) {
+			return 0;
+		}
+
+		const Position &position = m_session.position();
+		const int32_t standPat = evaluate(position);
+		if (standPat >= beta || ply >= MAX_PLY - 1) {
+			return standPat;
+		}
+		alpha = std::max(alpha, standPat);
+
+		moves::Moves &moves = m_moves[ply];
+		moves.clear();
+		PositionMoves::getValidMoves(position, moves);
+		orderMoves(moves, 0, ply);
+
+		for (size_t i = 0; i < moves.size() && victim(m_session.position(), moves[i]) != 0; ++i) {
+			const moves::Move move = moves[i];
+			m_session.makeMove(move);
+			const int32_t score = -quiescence(ply + 1, -beta, -alpha);
+			m_session.undoMove(move);
+
+			if (m_stopped) {
+				return alpha;
+			}
+			if (score >= beta) {
+				return score;
+			}
+			alpha = std::max(alpha, score);
+		}
+		return alpha;
+	}
+
+	// Mate scores are stored relative to the position so they stay right when reached from another ply
+	static int32_t toTable(int32_t score, size_t ply) {
+		return score >= MATE - int32_t(MAX_PLY) ? score + int32_t(ply) : score <= -MATE + int32_t(MAX_PLY) ? score - int32_t(ply) : score;
+	}
+
+	static int32_t fromTable(int32_t score, size_t ply) {
+		return score >= MATE - int32_t(MAX_PLY) ? score - int32_t(ply) : score <= -MATE + int32_t(MAX_PLY) ? score + int32_t(ply) : score;
+	}
+
+	TranspositionTable &m_table;
+	const Tablebase *m_tablebase = nullptr;
+	Session m_session;
+	Limits m_limits;
+	bool m_stopped = false;
+	uint64_t m_nodes = 0;
+
+	std::array<moves::Moves, MAX_PLY> m_moves;
+	std::array<uint64_t, MAX_PLY> m_path;
+	std::array<std::array<uint16_t, 2>, MAX_PLY> m_killers;
+};
+
+} //namespace phase4::engine::board
+
+#endif
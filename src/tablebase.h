@@ -0,0 +1,579 @@
+#ifndef PHASE4_ENGINE_BOARD_TABLEBASE_H
+#define PHASE4_ENGINE_BOARD_TABLEBASE_H
+
+#include <phase4/engine/board/position.h>
+#include <phase4/engine/board/position_moves.h>
+#include <phase4/engine/board/session.h>
+#include <phase4/engine/common/piece_color.h>
+#include <phase4/engine/common/piece_type.h>
+#include <phase4/engine/moves/move.h>
+
+#include "book.h"
+#include "position_view.h"
+#include "wall_slides.h"
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace phase4::engine::board {
+
+// Perfect play for endings of a few pieces with the walls on the board, made by tools/tablebase
+//
+// A table holds one material, such as KQvK, with an entry for every placement of the walls, side to move and pieces
+// DTM tables hold a byte per entry, 0 for a draw, otherwise the plies to mate plus one, odd plies win for the side to move and even plies lose
+// WDL tables hold two bits per entry with only the win, draw or loss, a quarter of the size for the search to probe
+// Pieces are indexed by the 60 squares the walls leave free, pieces of the same kind as one set of squares
+// The wall blocks map onto each other when the board is turned or mirrored, so a table only holds the walls of one corner triangle,
+// or with pawns, that only keep their moves when the files are mirrored, the walls on the four files of the queen side
+// Castling, en passant and the fifty move rule are not part of it
+// Files are written and read in the byte order of the machine, every supported platform is little endian
+class Tablebase {
+public:
+	static constexpr uint32_t MAGIC = 0x42543450; // P4TB
+	static constexpr uint32_t VERSION = 2;
+	static constexpr size_t MAX_PIECES = 4;
+	static constexpr size_t WALL_BLOCKS = 16; // 2x2 blocks on even files and ranks
+	static constexpr size_t PAWNLESS_BLOCKS = 3; // a1, a3 and c3, the others are turned or mirrored onto them
+	static constexpr size_t PAWN_BLOCKS = 8; // On the a to d files
+	static constexpr size_t FREE_SQUARES = 60;
+	static constexpr uint8_t DRAW_VALUE = 0;
+	static constexpr uint8_t INVALID_VALUE = 255; // Pieces that overlap, a side to move that could take the king or a mirrored copy
+	static constexpr size_t MAX_PLIES = 253;
+
+	enum Format : uint32_t {
+		DTM = 0,
+		WDL = 1,
+	};
+
+	// Two bit values of WDL tables
+	static constexpr uint8_t WDL_DRAW = 0;
+	static constexpr uint8_t WDL_WIN = 1;
+	static constexpr uint8_t WDL_LOSS = 2;
+	static constexpr uint8_t WDL_INVALID = 3;
+
+	enum Wdl : int8_t {
+		LOSS = -1,
+		DRAW = 0,
+		WIN = 1,
+	};
+
+	// For the side to move
+	struct Result {
+		Wdl wdl = DRAW;
+		uint8_t plies = 0; // Plies to mate with best play by both sides, 0 for draws
+		bool hasPlies = true; // False from a WDL table, plies is then 0
+	};
+
+	// The pieces of a table, white then black and each side king first then by falling value
+	struct Material {
+		std::array<uint8_t, MAX_PIECES> pieces = {}; // color << 3 | type
+		uint8_t count = 0;
+
+		static uint8_t piece(common::PieceColor color, common::PieceType type) {
+			return static_cast<uint8_t>((color.get_raw_value() << 3) | type.get_raw_value());
+		}
+
+		uint32_t key() const {
+			uint32_t key = count;
+			for (size_t i = 0; i < count; ++i) {
+				key |= uint32_t(pieces[i]) << (4 + i * 4);
+			}
+			return key;
+		}
+
+		bool operator==(const Material &other) const {
+			return key() == other.key();
+		}
+
+		bool operator!=(const Material &other) const {
+			return key() != other.key();
+		}
+
+		bool pawns() const {
+			for (size_t i = 0; i < count; ++i) {
+				if ((pieces[i] & 7) == common::PieceType::PAWN.get_raw_value()) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// Pieces of the same kind from the one at i on, they share a set of squares in the index
+		size_t same(size_t i) const {
+			size_t same = 1;
+			while (i + same < count && pieces[i + same] == pieces[i]) {
+				++same;
+			}
+			return same;
+		}
+
+		// Wall blocks its table holds
+		size_t blocks() const {
+			return pawns() ? PAWN_BLOCKS : PAWNLESS_BLOCKS;
+		}
+
+		// Entries of its table
+		size_t size() const {
+			size_t size = blocks() * 2;
+			for (size_t i = 0; i < count; i += same(i)) {
+				size *= binomial(FREE_SQUARES, same(i));
+			}
+			return size;
+		}
+
+		// Nothing when a side has no king or there are more pieces than a table holds
+		static std::optional<Material> of(const Position &position) {
+			using namespace common;
+
+			Material material;
+			for (const PieceColor color : { PieceColor::WHITE, PieceColor::BLACK }) {
+				for (const PieceType type : ORDER) {
+					const size_t pieces = std::bitset<64>(position.colorPieceMask(color, type).get_raw_value()).count();
+					if (material.count + pieces > MAX_PIECES) {
+						return {};
+					}
+					for (size_t i = 0; i < pieces; ++i) {
+						material.pieces[material.count++] = piece(color, type);
+					}
+				}
+			}
+			return material.valid() ? std::optional<Material>(material) : std::nullopt;
+		}
+
+		// Names like KQvK or KRPvKR, the side with the pieces before the v is white
+		static std::optional<Material> parse(std::string_view name) {
+			using namespace common;
+
+			Material material;
+			PieceColor color = PieceColor::WHITE;
+			for (const char c : name) {
+				if (c == 'v' && color == PieceColor::WHITE) {
+					color = PieceColor::BLACK;
+					continue;
+				}
+
+				const char *found = std::strchr(LETTERS, c);
+				if (c == '\0' || !found || material.count == MAX_PIECES) {
+					return {};
+				}
+				material.pieces[material.count++] = piece(color, PieceType(static_cast<uint8_t>(found - LETTERS)));
+			}
+
+			// Put the pieces in the order of positions so names can be written either way
+			std::sort(material.pieces.begin(), material.pieces.begin() + material.count, [](uint8_t a, uint8_t b) {
+				return (a >> 3) != (b >> 3) ? (a >> 3) < (b >> 3) : (a & 7) > (b & 7);
+			});
+			return color == PieceColor::BLACK && material.valid() ? std::optional<Material>(material) : std::nullopt;
+		}
+
+		std::string name() const {
+			std::string name;
+			for (size_t i = 0; i < count; ++i) {
+				if (i > 0 && (pieces[i] >> 3) != (pieces[i - 1] >> 3)) {
+					name.push_back('v');
+				}
+				name.push_back(LETTERS[pieces[i] & 7]);
+			}
+			return name;
+		}
+
+	private:
+		static constexpr const char *LETTERS = "PNBRQK"; // By piece type
+		static constexpr std::array<common::PieceType, 6> ORDER = { common::PieceType::KING, common::PieceType::QUEEN, common::PieceType::ROOK,
+			common::PieceType::BISHOP, common::PieceType::KNIGHT, common::PieceType::PAWN };
+
+		bool valid() const {
+			const uint8_t whiteKing = piece(common::PieceColor::WHITE, common::PieceType::KING);
+			const uint8_t blackKing = piece(common::PieceColor::BLACK, common::PieceType::KING);
+			size_t kings = 0;
+			for (size_t i = 0; i < count; ++i) {
+				kings += pieces[i] == whiteKing || pieces[i] == blackKing ? 1 : 0;
+			}
+			return count >= 2 && kings == 2 && pieces[0] == whiteKing && std::find(pieces.begin(), pieces.begin() + count, blackKing) != pieces.begin() + count;
+		}
+	};
+
+	struct Header {
+		uint32_t magic = MAGIC;
+		uint32_t version = VERSION;
+		uint32_t material = 0; // Material::key()
+		uint32_t format = DTM;
+		uint64_t count = 0; // Entries, a WDL table has a quarter as many bytes rounded up
+	};
+
+	static_assert(sizeof(Header) == 24, "Tablebase headers are read straight from the file");
+
+	// The pieces in the order of the material, the walls and the side to move
+	struct Placement {
+		std::array<uint8_t, MAX_PIECES> squares = {};
+		uint64_t walls = 0;
+		common::PieceColor colorToMove = common::PieceColor::WHITE;
+	};
+
+	static constexpr uint64_t wallBlock(size_t block) {
+		const size_t square = (block % 4) * 2 + (block / 4) * 16;
+		return (uint64_t(3) << square) | (uint64_t(3) << (square + 8));
+	}
+
+	// Sets of k squares out of n
+	static constexpr size_t binomial(size_t n, size_t k) {
+		if (k > n) {
+			return 0;
+		}
+
+		size_t result = 1;
+		for (size_t i = 0; i < k; ++i) {
+			result = result * (n - i) / (i + 1);
+		}
+		return result;
+	}
+
+	// The square of a piece among those the walls leave free, nothing on a wall
+	static std::optional<size_t> freeSquare(size_t square, uint64_t walls) {
+		if ((walls >> square) & 1) {
+			return {};
+		}
+		return square - std::bitset<64>(walls & ((uint64_t(1) << square) - 1)).count();
+	}
+
+	// The board square of one of those the walls leave free
+	static uint8_t boardSquare(size_t free, uint64_t walls) {
+		size_t square = 0;
+		for (;; ++square) {
+			if (((walls >> square) & 1) == 0 && free-- == 0) {
+				return static_cast<uint8_t>(square);
+			}
+		}
+	}
+
+	// Where the position is in the table of its material, nothing when it is not in one
+	static std::optional<size_t> index(const Position &position, const Material &material) {
+		using namespace common;
+
+		Placement placement;
+		placement.walls = position.walls().get_raw_value();
+		placement.colorToMove = position.colorToMove();
+		uint64_t taken = 0;
+		for (size_t i = 0; i < material.count; ++i) {
+			const uint64_t mask = position.colorPieceMask(PieceColor(static_cast<uint8_t>(material.pieces[i] >> 3)), PieceType(static_cast<uint8_t>(material.pieces[i] & 7))).get_raw_value() & ~taken;
+			if (mask == 0) {
+				return {};
+			}
+
+			placement.squares[i] = static_cast<uint8_t>(WallSlides::lowestSquare(mask));
+			taken |= uint64_t(1) << placement.squares[i];
+		}
+		return index(material, placement);
+	}
+
+	// The walls are turned and mirrored into the blocks the table holds and the pieces with them
+	// Walls on the diagonal stay there when the board is turned over it, the lower index of the two is taken
+	static std::optional<size_t> index(const Material &material, const Placement &placement) {
+		const size_t lowest = WallSlides::lowestSquare(placement.walls);
+		if (lowest >= 64 || wallBlock((lowest / 16) * 4 + (lowest % 8) / 2) != placement.walls) {
+			return {};
+		}
+
+		size_t x = (lowest % 8) / 2;
+		size_t y = lowest / 16;
+		Symmetry symmetry;
+		symmetry.files = x > 1;
+		x = symmetry.files ? 3 - x : x;
+		if (!material.pawns()) {
+			symmetry.ranks = y > 1;
+			y = symmetry.ranks ? 3 - y : y;
+			symmetry.diagonal = x > y;
+			if (symmetry.diagonal) {
+				std::swap(x, y);
+			}
+		}
+
+		const size_t block = material.pawns() ? x + y * 2 : x + y;
+		const uint64_t walls = wallBlock(x + y * 4);
+		const std::optional<size_t> index = pieceIndex(material, placement, symmetry, block, walls);
+		if (!material.pawns() && x == y && index) {
+			symmetry.diagonal = true;
+			return std::min(*index, *pieceIndex(material, placement, symmetry, block, walls));
+		}
+		return index;
+	}
+
+	// The placement of an entry, index() gives the entry back unless the placement is a copy of another one
+	// Pieces may overlap, nothing about the position is checked
+	static Placement placement(const Material &material, size_t index) {
+		std::array<size_t, MAX_PIECES> first = {};
+		size_t sets = 0;
+		for (size_t i = 0; i < material.count; i += material.same(i)) {
+			first[sets++] = i;
+		}
+
+		Placement placement;
+		std::array<size_t, MAX_PIECES> free = {};
+		for (size_t set = sets; set-- > 0;) {
+			const size_t same = material.same(first[set]);
+			size_t rank = index % binomial(FREE_SQUARES, same);
+			index /= binomial(FREE_SQUARES, same);
+			for (size_t j = same; j-- > 0;) {
+				size_t square = j;
+				while (binomial(square + 1, j + 1) <= rank) {
+					++square;
+				}
+				rank -= binomial(square, j + 1);
+				free[first[set] + j] = square;
+			}
+		}
+
+		placement.colorToMove = common::PieceColor(static_cast<uint8_t>(index % 2));
+		const size_t block = index / 2;
+		const size_t y = material.pawns() ? block / 2 : (block > 0 ? 1 : 0);
+		const size_t x = material.pawns() ? block % 2 : block - y;
+		placement.walls = wallBlock(x + y * 4);
+		for (size_t i = 0; i < material.count; ++i) {
+			placement.squares[i] = boardSquare(free[i], placement.walls);
+		}
+		return placement;
+	}
+
+	static uint8_t encode(const Result &result) {
+		return result.wdl == DRAW ? DRAW_VALUE : static_cast<uint8_t>(result.plies + 1);
+	}
+
+	static std::optional<Result> decode(uint8_t value) {
+		if (value == INVALID_VALUE) {
+			return {};
+		}
+
+		Result result;
+		if (value != DRAW_VALUE) {
+			result.plies = static_cast<uint8_t>(value - 1);
+			result.wdl = result.plies % 2 == 1 ? WIN : LOSS;
+		}
+		return result;
+	}
+
+	// The two bits of a WDL table for a DTM value
+	static uint8_t wdlOf(uint8_t value) {
+		if (value == INVALID_VALUE) {
+			return WDL_INVALID;
+		}
+		return value == DRAW_VALUE ? WDL_DRAW : (value - 1) % 2 == 1 ? WDL_WIN : WDL_LOSS;
+	}
+
+	static std::optional<Result> decodeWdl(uint8_t value) {
+		if (value == WDL_INVALID) {
+			return {};
+		}
+
+		Result result;
+		result.wdl = value == WDL_WIN ? WIN : value == WDL_LOSS ? LOSS : DRAW;
+		result.hasPlies = false;
+		return result;
+	}
+
+	// Bytes of the values of a table
+	static size_t bytes(Format format, size_t count) {
+		return format == WDL ? (count + 3) / 4 : count;
+	}
+
+	// Maps a table file, nothing beyond the header is read until probed
+	bool open(const char *path) {
+		std::unique_ptr<MappedFile> file = std::make_unique<MappedFile>();
+		if (!file->open(path)) {
+			return false;
+		}
+		const uint8_t *data = file->data();
+		const size_t size = file->size();
+		return add(data, size, std::move(file));
+	}
+
+	// Uses a table already in memory, the data must outlive the tablebase
+	bool attach(const uint8_t *data, size_t size) {
+		return add(data, size, nullptr);
+	}
+
+	void close() {
+		m_tables.clear();
+	}
+
+	size_t tables() const {
+		return m_tables.size();
+	}
+
+	bool contains(const Material &material) const {
+		return find(material) != nullptr;
+	}
+
+	// Nothing when there is no table of the material, two bare kings are always a draw
+	// A DTM table is probed before a WDL table of the same material
+	std::optional<Result> probe(const Position &position) const {
+		if (std::bitset<64>(position.occupancySummary().get_raw_value() & ~position.walls().get_raw_value()).count() > MAX_PIECES) {
+			return {};
+		}
+
+		const std::optional<Material> material = Material::of(position);
+		if (!material) {
+			return {};
+		}
+		if (material->count == 2) {
+			return Result();
+		}
+
+		const Table *table = find(*material);
+		const std::optional<size_t> index = table ? Tablebase::index(position, *material) : std::nullopt;
+		if (!index || *index >= table->count) {
+			return {};
+		}
+		if (table->format == WDL) {
+			return decodeWdl(static_cast<uint8_t>((table->values[*index / 4] >> (*index % 4 * 2)) & 3));
+		}
+		return decode(table->values[*index]);
+	}
+
+	std::optional<Result> probe(const PositionView &view) const {
+		return probe(view.current());
+	}
+
+	// The move that mates fastest, holds the draw or holds out the longest, nothing when the position is not known
+	// From a WDL table any winning move is as good as another, it needs the DTM table to make progress
+	std::optional<moves::Move> bestMove(const Position &position) const {
+		if (!probe(position)) {
+			return {};
+		}
+
+		moves::Moves validMoves;
+		PositionMoves::getValidMoves(position, validMoves);
+		Session session;
+		session.setPosition(position);
+
+		std::optional<moves::Move> best;
+		int32_t bestRank = INT32_MIN;
+		for (size_t i = 0; i < validMoves.size(); ++i) {
+			session.makeMove(validMoves[i]);
+			const std::optional<Result> result = probe(session.position());
+			session.undoMove(validMoves[i]);
+
+			// The result is for the other side, sooner is better when winning and later when losing
+			const int32_t rank = result ? -(result->wdl * (1000 - int32_t(result->plies))) : INT32_MIN + 1;
+			if (rank > bestRank) {
+				best = validMoves[i];
+				bestRank = rank;
+			}
+		}
+		return best;
+	}
+
+	// Starts a generated table, its count values indexed like index() are written after the header
+	// WDL values are packed four to a byte from the lowest bits up
+	static bool writeHeader(std::FILE *file, const Material &material, size_t count, Format format = DTM) {
+		Header header;
+		header.material = material.key();
+		header.format = format;
+		header.count = count;
+		return std::fwrite(&header, sizeof(header), 1, file) == 1;
+	}
+
+private:
+	// The turn and mirrors that bring the walls into the blocks of a table, files and ranks are mirrored before the diagonal
+	struct Symmetry {
+		bool files = false;
+		bool ranks = false;
+		bool diagonal = false;
+
+		uint8_t apply(uint8_t square) const {
+			const uint8_t x = files ? 7 - square % 8 : square % 8;
+			const uint8_t y = ranks ? 7 - square / 8 : square / 8;
+			return diagonal ? static_cast<uint8_t>(y + x * 8) : static_cast<uint8_t>(x + y * 8);
+		}
+	};
+
+	// The index of the pieces once the symmetry brought the walls into the block the table holds
+	static std::optional<size_t> pieceIndex(const Material &material, const Placement &placement, const Symmetry &symmetry, size_t block, uint64_t walls) {
+		size_t index = block * 2 + placement.colorToMove.get_raw_value();
+		for (size_t i = 0; i < material.count; i += material.same(i)) {
+			const size_t same = material.same(i);
+			std::array<size_t, MAX_PIECES> free = {};
+			for (size_t j = 0; j < same; ++j) {
+				const std::optional<size_t> square = placement.squares[i + j] < 64 ? freeSquare(symmetry.apply(placement.squares[i + j]), walls) : std::nullopt;
+				if (!square) {
+					return {};
+				}
+				free[j] = *square;
+			}
+
+			// Pieces of the same kind are a set, its rank among the sets of that many squares
+			std::sort(free.begin(), free.begin() + same);
+			size_t set = 0;
+			for (size_t j = 0; j < same; ++j) {
+				if (j > 0 && free[j] == free[j - 1]) {
+					return {};
+				}
+				set += binomial(free[j], j + 1);
+			}
+			index = index * binomial(FREE_SQUARES, same) + set;
+		}
+		return index;
+	}
+
+	struct Table {
+		std::unique_ptr<MappedFile> file; // Empty when attached
+		uint32_t material = 0;
+		Format format = DTM;
+		const uint8_t *values = nullptr;
+		size_t count = 0;
+	};
+
+	// A newer table of the same material and format replaces the one before
+	bool add(const uint8_t *data, size_t size, std::unique_ptr<MappedFile> file) {
+		Header header;
+		if (size < sizeof(header)) {
+			return false;
+		}
+		std::memcpy(&header, data, sizeof(header));
+		if (header.magic != MAGIC || header.version != VERSION || (header.format != DTM && header.format != WDL) ||
+				bytes(Format(header.format), header.count) != size - sizeof(header)) {
+			return false;
+		}
+
+		Table table;
+		table.file = std::move(file);
+		table.material = header.material;
+		table.format = Format(header.format);
+		table.values = data + sizeof(header);
+		table.count = header.count;
+		for (Table &existing : m_tables) {
+			if (existing.material == table.material && existing.format == table.format) {
+				existing = std::move(table);
+				return true;
+			}
+		}
+		m_tables.push_back(std::move(table));
+		return true;
+	}
+
+	// Only a handful of tables are ever open, a scan is as fast as hashing
+	const Table *find(const Material &material) const {
+		const uint32_t key = material.key();
+		const Table *found = nullptr;
+		for (const Table &table : m_tables) {
+			if (table.material == key && (!found || table.format == DTM)) {
+				found = &table;
+			}
+		}
+		return found;
+	}
+
+	std::vector<Table> m_tables;
+};
+
+} //namespace phase4::engine::board
+
+#endif
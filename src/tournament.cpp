@@ -0,0 +1,332 @@
+#include "tournament.h"
+
+#include <godot_cpp/classes/worker_thread_pool.hpp>
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/core/property_info.hpp>
+#include <godot_cpp/variant/callable_method_pointer.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+using namespace godot;
+
+void Tournament::_bind_methods() {
+	const StringName class_name = "Tournament";
+
+	{
+		BIND_ENUM_CONSTANT(PLAYER_RANDOM);
+		BIND_ENUM_CONSTANT(PLAYER_GREEDY);
+		BIND_ENUM_CONSTANT(PLAYER_MAX);
+	}
+
+	{
+		BIND_ENUM_CONSTANT(WALL_PLACEMENT_NONE);
+		BIND_ENUM_CONSTANT(WALL_PLACEMENT_RANDOM);
+	}
+
+	{
+		BIND_ENUM_CONSTANT(OUTCOME_UNFINISHED);
+		BIND_ENUM_CONSTANT(OUTCOME_WHITE_WON);
+		BIND_ENUM_CONSTANT(OUTCOME_BLACK_WON);
+		BIND_ENUM_CONSTANT(OUTCOME_STALEMATE);
+		BIND_ENUM_CONSTANT(OUTCOME_REPETITION);
+		BIND_ENUM_CONSTANT(OUTCOME_MAX_PLIES);
+		BIND_ENUM_CONSTANT(OUTCOME_MAX);
+	}
+
+	{
+		const StringName get_white_player_method = "get_white_player";
+		const StringName set_white_player_method = "set_white_player";
+		const StringName white_player_property = "white_player";
+		ClassDB::bind_method(D_METHOD(get_white_player_method), &Tournament::get_white_player);
+		ClassDB::bind_method(D_METHOD(set_white_player_method, white_player_property), &Tournament::set_white_player);
+		ClassDB::add_property(class_name, PropertyInfo(Variant::INT, white_player_property), set_white_player_method, get_white_player_method);
+	}
+
+	{
+		const StringName get_black_player_method = "get_black_player";
+		const StringName set_black_player_method = "set_black_player";
+		const StringName black_player_property = "black_player";
+		ClassDB::bind_method(D_METHOD(get_black_player_method), &Tournament::get_black_player);
+		ClassDB::bind_method(D_METHOD(set_black_player_method, black_player_property), &Tournament::set_black_player);
+		ClassDB::add_property(class_name, PropertyInfo(Variant::INT, black_player_property), set_black_player_method, get_black_player_method);
+	}
+
+	{
+		const StringName get_wall_placement_method = "get_wall_placement";
+		const StringName set_wall_placement_method = "set_wall_placement";
+		const StringName wall_placement_property = "wall_placement";
+		ClassDB::bind_method(D_METHOD(get_wall_placement_method), &Tournament::get_wall_placement);
+		ClassDB::bind_method(D_METHOD(set_wall_placement_method, wall_placement_property), &Tournament::set_wall_placement);
+		ClassDB::add_property(class_name, PropertyInfo(Variant::INT, wall_placement_property), set_wall_placement_method, get_wall_placement_method);
+	}
+
+	{
+		const StringName get_max_plies_method = "get_max_plies";
+		const StringName set_max_plies_method = "set_max_plies";
+		const StringName max_plies_property = "max_plies";
+		ClassDB::bind_method(D_METHOD(get_max_plies_method), &Tournament::get_max_plies);
+		ClassDB::bind_method(D_METHOD(set_max_plies_method, max_plies_property), &Tournament::set_max_plies);
+		ClassDB::add_property(class_name, PropertyInfo(Variant::INT, max_plies_property), set_max_plies_method, get_max_plies_method);
+	}
+
+	{
+		const StringName get_seed_method = "get_seed";
+		const StringName set_seed_method = "set_seed";
+		const StringName seed_property = "seed";
+		ClassDB::bind_method(D_METHOD(get_seed_method), &Tournament::get_seed);
+		ClassDB::bind_method(D_METHOD(set_seed_method, seed_property), &Tournament::set_seed);
+		ClassDB::add_property(class_name, PropertyInfo(Variant::INT, seed_property), set_seed_method, get_seed_method);
+	}
+
+	{
+		const StringName start_method = "start";
+		ClassDB::bind_method(D_METHOD(start_method, "games"), &Tournament::start);
+	}
+
+	{
+		const StringName cancel_method = "cancel";
+		ClassDB::bind_method(D_METHOD(cancel_method), &Tournament::cancel);
+	}
+
+	{
+		const StringName wait_method = "wait";
+		ClassDB::bind_method(D_METHOD(wait_method), &Tournament::wait);
+	}
+
+	{
+		const StringName is_running_method = "is_running";
+		ClassDB::bind_method(D_METHOD(is_running_method), &Tournament::is_running);
+	}
+
+	{
+		const StringName get_record_size_method = "get_record_size";
+		ClassDB::bind_method(D_METHOD(get_record_size_method), &Tournament::get_record_size);
+	}
+
+	{
+		const StringName get_results_method = "get_results";
+		ClassDB::bind_method(D_METHOD(get_results_method), &Tournament::get_results);
+	}
+
+	{
+		const StringName get_summary_method = "get_summary";
+		ClassDB::bind_method(D_METHOD(get_summary_method), &Tournament::get_summary);
+	}
+
+	ADD_SIGNAL(MethodInfo(StringName(SIGNAL_FINISHED), PropertyInfo(Variant::DICTIONARY, "summary")));
+}
+
+Tournament::~Tournament() {
+	if (task != -1) {
+		cancelled = true;
+		WorkerThreadPool::get_singleton()->wait_for_group_task_completion(task);
+	}
+}
+
+std::unique_ptr<phase4::engine::board::Player> Tournament::make_player(PlayerType type) {
+	using namespace phase4::engine::board;
+
+	switch (type) {
+		case PLAYER_GREEDY:
+			return std::make_unique<GreedyCapturePlayer>();
+		default:
+			return std::make_unique<RandomPlayer>();
+	}
+}
+
+// Runs on a worker thread, only touches its own record so games never wait on each other
+void Tournament::play_game(uint32_t index) {
+	using namespace phase4::engine::board;
+	using namespace phase4::engine::common;
+	using namespace phase4::engine::moves;
+
+	int32_t *record = records + index * get_record_size();
+	Random random(static_cast<uint64_t>(seed) ^ (uint64_t(index) * 0xD1B54A32D192ED03ull));
+	const std::array<std::unique_ptr<Player>, 2> players = { make_player(white_player), make_player(black_player) };
+
+	// Players only need the moves, the board overlays and the shared move cache would cost every ply and contend between games
+	std::unique_ptr<PositionView> position = std::make_unique<PositionView>();
+	position->setOverlays(false);
+	if (wall_placement == WALL_PLACEMENT_RANDOM) {
+		const size_t first = random.below(64);
+		for (size_t i = 0; i < 64 && position->size() == 1; ++i) {
+			position->setWalls(Square((first + i) % 64));
+		}
+	}
+
+	Outcome outcome = OUTCOME_MAX_PLIES;
+	int32_t plies = 0;
+	for (; plies < max_plies; ++plies) {
+		if (cancelled) {
+			outcome = OUTCOME_UNFINISHED;
+			break;
+		}
+
+		const Position &current = position->current();
+		if (position->isThreefoldRepetition()) {
+			outcome = OUTCOME_REPETITION;
+			break;
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+		std::optional<Move> move = players[current.colorToMove().get_raw_value()]->choose(*position, random);
+		if (!move) {
+			if (!current.isKingChecked(current.colorToMove())) {
+				outcome = OUTCOME_STALEMATE;
+			} else {
+				outcome = current.colorToMove() == PieceColor::WHITE ? OUTCOME_BLACK_WON : OUTCOME_WHITE_WON;
+			}
+			break;
+		}
+		const bool moved = position->makeMove(*move).has_value();
+		const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		record[RECORD_HEADER + plies] = static_cast<int32_t>(std::min<int64_t>(elapsed, INT32_MAX));
+
+		if (!moved) {
+			outcome = OUTCOME_UNFINISHED; // The player picked a move that is not valid
+			break;
+		}
+	}
+
+	record[0] = outcome;
+	record[1] = plies;
+
+	if (--remaining == 0) {
+		callable_mp(this, &Tournament::finish).call_deferred();
+	}
+}
+
+void Tournament::finish() {
+	if (task == -1) {
+		return; // Already waited for
+	}
+
+	WorkerThreadPool::get_singleton()->wait_for_group_task_completion(task);
+	task = -1;
+	records = nullptr;
+	emit_signal(StringName(SIGNAL_FINISHED), get_summary());
+}
+
+void Tournament::set_white_player(PlayerType type) {
+	ERR_FAIL_COND_MSG(is_running(), "Players can not change while games are played.");
+	ERR_FAIL_INDEX(type, PLAYER_MAX);
+	white_player = type;
+}
+
+Tournament::PlayerType Tournament::get_white_player() const {
+	return white_player;
+}
+
+void Tournament::set_black_player(PlayerType type) {
+	ERR_FAIL_COND_MSG(is_running(), "Players can not change while games are played.");
+	ERR_FAIL_INDEX(type, PLAYER_MAX);
+	black_player = type;
+}
+
+Tournament::PlayerType Tournament::get_black_player() const {
+	return black_player;
+}
+
+void Tournament::set_wall_placement(WallPlacement placement) {
+	ERR_FAIL_COND_MSG(is_running(), "Wall placement can not change while games are played.");
+	wall_placement = placement;
+}
+
+Tournament::WallPlacement Tournament::get_wall_placement() const {
+	return wall_placement;
+}
+
+void Tournament::set_max_plies(int64_t plies) {
+	ERR_FAIL_COND_MSG(is_running(), "The game length can not change while games are played.");
+	ERR_FAIL_COND(plies < 1);
+	max_plies = plies;
+}
+
+int64_t Tournament::get_max_plies() const {
+	return max_plies;
+}
+
+void Tournament::set_seed(int64_t value) {
+	ERR_FAIL_COND_MSG(is_running(), "The seed can not change while games are played.");
+	seed = value;
+}
+
+int64_t Tournament::get_seed() const {
+	return seed;
+}
+
+// Starts playing the games in the background, finished is emitted once all of them end
+Error Tournament::start(int64_t games) {
+	ERR_FAIL_COND_V_MSG(is_running(), ERR_BUSY, "A tournament is already being played.");
+	ERR_FAIL_COND_V(games < 1 || games > UINT32_MAX, ERR_INVALID_PARAMETER);
+
+	results = PackedInt32Array();
+	ERR_FAIL_COND_V(results.resize(games * get_record_size()) != OK, ERR_OUT_OF_MEMORY);
+	results.fill(0);
+	records = results.ptrw();
+
+	cancelled = false;
+	remaining = games;
+	task = WorkerThreadPool::get_singleton()->add_group_task(callable_mp(this, &Tournament::play_game), games, -1, false, "Tournament");
+	return OK;
+}
+
+// Games in progress stop at their next move and are reported as unfinished
+void Tournament::cancel() {
+	cancelled = true;
+}
+
+// Blocks until every game ended and emits finished right away
+void Tournament::wait() {
+	finish();
+}
+
+bool Tournament::is_running() const {
+	return task != -1;
+}
+
+// Number of values in the results for each game
+int64_t Tournament::get_record_size() const {
+	return RECORD_HEADER + max_plies;
+}
+
+PackedInt32Array Tournament::get_results() const {
+	ERR_FAIL_COND_V_MSG(is_running(), PackedInt32Array(), "Results are not ready until the tournament finished.");
+	return results;
+}
+
+Dictionary Tournament::get_summary() const {
+	ERR_FAIL_COND_V_MSG(is_running(), Dictionary(), "The summary is not ready until the tournament finished.");
+
+	const int64_t record_size = get_record_size();
+	const int64_t games = results.size() / record_size;
+	const int32_t *data = results.ptr();
+
+	PackedInt64Array outcomes;
+	outcomes.resize(OUTCOME_MAX);
+	outcomes.fill(0);
+	int64_t plies = 0;
+	int64_t move_time = 0;
+	int64_t longest_move = 0;
+	for (int64_t game = 0; game < games; ++game) {
+		const int32_t *record = data + game * record_size;
+		outcomes[record[0]] += 1;
+		plies += record[1];
+		for (int64_t ply = 0; ply < record[1]; ++ply) {
+			move_time += record[RECORD_HEADER + ply];
+			longest_move = std::max<int64_t>(longest_move, record[RECORD_HEADER + ply]);
+		}
+	}
+
+	Dictionary summary;
+	summary["games"] = games;
+	summary["outcomes"] = outcomes; // Games by Outcome
+	summary["white_wins"] = outcomes[OUTCOME_WHITE_WON];
+	summary["black_wins"] = outcomes[OUTCOME_BLACK_WON];
+	summary["draws"] = outcomes[OUTCOME_STALEMATE] + outcomes[OUTCOME_REPETITION] + outcomes[OUTCOME_MAX_PLIES];
+	summary["average_plies"] = games > 0 ? double(plies) / games : 0.0;
+	summary["average_move_usec"] = plies > 0 ? double(move_time) / plies : 0.0;
+	summary["longest_move_usec"] = longest_move;
+	return summary;
+}
@@ -0,0 +1,99 @@
+#ifndef TOURNAMENT_H
+#define TOURNAMENT_H
+
+#include "players.h"
+
+#include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+
+#include <atomic>
+#include <memory>
+
+namespace godot {
+
+// Plays many games between native players at once, one game per WorkerThreadPool task
+//
+// Results are one packed buffer with a fixed size record per game:
+// outcome, plies played, then the time each move took in microseconds for max_plies moves
+class Tournament : public RefCounted {
+	GDCLASS(Tournament, RefCounted)
+
+public:
+	enum PlayerType {
+		PLAYER_RANDOM,
+		PLAYER_GREEDY,
+		PLAYER_MAX,
+	};
+
+	enum WallPlacement {
+		WALL_PLACEMENT_NONE,
+		WALL_PLACEMENT_RANDOM, // Each game starts with walls on a random square
+	};
+
+	enum Outcome {
+		OUTCOME_UNFINISHED, // Cancelled before it ended
+		OUTCOME_WHITE_WON,
+		OUTCOME_BLACK_WON,
+		OUTCOME_STALEMATE,
+		OUTCOME_REPETITION,
+		OUTCOME_MAX_PLIES,
+		OUTCOME_MAX,
+	};
+
+	inline static const char *SIGNAL_FINISHED = "finished";
+
+private:
+	static constexpr int64_t RECORD_HEADER = 2;
+
+	PlayerType white_player = PLAYER_RANDOM;
+	PlayerType black_player = PLAYER_RANDOM;
+	WallPlacement wall_placement = WALL_PLACEMENT_NONE;
+	int64_t max_plies = 200;
+	int64_t seed = 0;
+
+	PackedInt32Array results;
+	int32_t *records = nullptr; // Written by the games while they run
+	int64_t task = -1;
+	std::atomic<int64_t> remaining{ 0 };
+	std::atomic<bool> cancelled{ false };
+
+	static std::unique_ptr<phase4::engine::board::Player> make_player(PlayerType type);
+
+	void play_game(uint32_t index);
+	void finish();
+
+protected:
+	static void _bind_methods();
+
+public:
+	~Tournament();
+
+	void set_white_player(PlayerType type);
+	PlayerType get_white_player() const;
+	void set_black_player(PlayerType type);
+	PlayerType get_black_player() const;
+	void set_wall_placement(WallPlacement placement);
+	WallPlacement get_wall_placement() const;
+	void set_max_plies(int64_t plies);
+	int64_t get_max_plies() const;
+	void set_seed(int64_t value);
+	int64_t get_seed() const;
+
+	Error start(int64_t games);
+	void cancel();
+	void wait();
+	bool is_running() const;
+
+	int64_t get_record_size() const;
+	PackedInt32Array get_results() const;
+	Dictionary get_summary() const;
+};
+
+} //namespace godot
+
+VARIANT_ENUM_CAST(godot::Tournament::PlayerType);
+VARIANT_ENUM_CAST(godot::Tournament::WallPlacement);
+VARIANT_ENUM_CAST(godot::Tournament::Outcome);
+
+#endif
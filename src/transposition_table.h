@@ -0,0 +1,89 @@
+#ifndef PHASE4_ENGINE_BOARD_TRANSPOSITION_TABLE_H
+#define PHASE4_ENGINE_BOARD_TRANSPOSITION_TABLE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace phase4::engine::board {
+
+// Search results by position hash, safe to share between threads without locks
+// Each slot stores its data and the key xor the data, a slot torn by two writers no longer matches its key and is ignored
+class TranspositionTable {
+public:
+	enum Bound : uint8_t {
+		NONE,
+		EXACT,
+		LOWER, // The score is at least this, the search failed high
+		UPPER, // The score is at most this, no move raised alpha
+	};
+
+	struct Entry {
+		uint16_t move = 0; // from | to << 6 | flags << 12, 0 when there is none
+		int16_t score = 0;
+		uint8_t depth = 0;
+		Bound bound = NONE;
+	};
+
+	explicit TranspositionTable(size_t bytes = 16 * 1024 * 1024) {
+		resize(bytes);
+	}
+
+	// Rounded down to a power of two slots, clears the table
+	void resize(size_t bytes) {
+		size_t count = 1;
+		while (count * 2 * sizeof(Slot) <= bytes) {
+			count *= 2;
+		}
+		m_slots = std::make_unique<Slot[]>(count);
+		m_mask = count - 1;
+	}
+
+	void clear() {
+		for (size_t i = 0; i <= m_mask; ++i) {
+			m_slots[i].key.store(0, std::memory_order_relaxed);
+			m_slots[i].data.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	bool probe(uint64_t key, Entry &entry) const {
+		const Slot &slot = m_slots[key & m_mask];
+		const uint64_t data = slot.data.load(std::memory_order_relaxed);
+		if ((slot.key.load(std::memory_order_relaxed) ^ data) != key || data == 0) {
+			return false;
+		}
+
+		entry.move = static_cast<uint16_t>(data);
+		entry.score = static_cast<int16_t>(data >> 16);
+		entry.depth = static_cast<uint8_t>(data >> 32);
+		entry.bound = static_cast<Bound>((data >> 40) & 3);
+		return true;
+	}
+
+	// Replaces the slot unless it holds a deeper result for the same position
+	void store(uint64_t key, const Entry &entry) {
+		Slot &slot = m_slots[key & m_mask];
+		Entry existing;
+		if (probe(key, existing) && existing.depth > entry.depth && entry.bound != EXACT) {
+			return;
+		}
+
+		const uint64_t data = uint64_t(entry.move) | (uint64_t(static_cast<uint16_t>(entry.score)) << 16) | (uint64_t(entry.depth) << 32) | (uint64_t(entry.bound) << 40);
+		slot.key.store(key ^ data, std::memory_order_relaxed);
+		slot.data.store(data, std::memory_order_relaxed);
+	}
+
+private:
+	struct Slot {
+		std::atomic<uint64_t> key{ 0 };
+		std::atomic<uint64_t> data{ 0 };
+	};
+
+	std::unique_ptr<Slot[]> m_slots;
+	size_t m_mask = 0;
+};
+
+} //namespace phase4::engine::board
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef PHASE4_ENGINE_BOARD_VARIATION_TREE_H
+#define PHASE4_ENGINE_BOARD_VARIATION_TREE_H
+
+#include <phase4/engine/common/bitboard.h>
+#include <phase4/engine/common/fast_vector.h>
+#include <phase4/engine/common/square.h>
+#include <phase4/engine/moves/move.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace phase4::engine::board {
+
+// Legal destinations of every square for one position, with the attacks the board overlays draw
+struct ValidDestinations {
+	std::array<common::Bitboard, 64> squares;
+	std::array<common::Bitboard, 2> attacked; // Squares attacked by each color
+	std::array<common::Bitboard, 2> pinned; // Pieces of each color pinned to their king
+	common::Bitboard checkers; // Pieces giving check to the side to move
+
+	void assign(const moves::Moves &moves) {
+		squares.fill(common::Bitboard(0));
+		for (size_t i = 0; i < moves.size(); ++i) {
+			squares[moves[i].from()] |= moves[i].to().asBitboard();
+		}
+	}
+};
+
+// Every position reached while exploring a game
+// Positions reached by different move orders share a single node
+class VariationTree {
+public:
+	using NodeId = uint32_t;
+	static constexpr NodeId NONE = UINT32_MAX;
+
+	struct Node {
+		uint64_t hash;
+		uint32_t firstEdge = NONE; // Most recently added continuation
+		std::unique_ptr<ValidDestinations> destinations; // Filled when the position is first viewed
+	};
+
+	// A ply leading from one node to another, EMPTY moves only placed walls
+	struct Edge {
+		moves::Move move;
+		common::Square wall;
+		NodeId node;
+		uint32_t nextEdge;
+	};
+
+	// Storage of the previous game is released rather than kept, a long session would otherwise hold on to it
+	void reset(uint64_t rootHash) {
+		std::vector<Node>().swap(m_nodes);
+		std::vector<Edge>().swap(m_edges);
+		std::vector<NodeId>().swap(m_index);
+		m_root = findOrAdd(rootHash);
+	}
+
+	// Makes room for the nodes and plies of a game so adding them does not allocate
+	void reserve(size_t plies) {
+		m_nodes.reserve(plies);
+		m_edges.reserve(plies);
+		if (m_index.size() < plies * 2) {
+			rehash(plies * 2);
+		}
+	}
+
+	NodeId root() const {
+		return m_root;
+	}
+
+	size_t size() const {
+		return m_nodes.size();
+	}
+
+	Node &node(NodeId id) {
+		return m_nodes[id];
+	}
+
+	const Node &node(NodeId id) const {
+		return m_nodes[id];
+	}
+
+	// Node of a position reached without a ply, such as one changed in place
+	NodeId findOrAdd(uint64_t hash) {
+		if ((m_nodes.size() + 1) * 2 > m_index.size()) {
+			rehash((m_nodes.size() + 1) * 2);
+		}
+
+		size_t slot = hash & (m_index.size() - 1);
+		for (; m_index[slot] != NONE; slot = (slot + 1) & (m_index.size() - 1)) {
+			if (m_nodes[m_index[slot]].hash == hash) {
+				return m_index[slot];
+			}
+		}
+
+		m_index[slot] = static_cast<NodeId>(m_nodes.size());
+		m_nodes.emplace_back().hash = hash;
+		return m_index[slot];
+	}
+
+	// Records a ply from parent and returns the node of the resulting position
+	NodeId play(NodeId parent, moves::Move move, common::Square wall, uint64_t hash) {
+		const NodeId child = findOrAdd(hash);
+
+		for (uint32_t edge = m_nodes[parent].firstEdge; edge != NONE; edge = m_edges[edge].nextEdge) {
+			if (m_edges[edge].node == child && m_edges[edge].move == move && m_edges[edge].wall == wall) {
+				return child;
+			}
+		}
+
+		m_edges.push_back(Edge{ move, wall, child, m_nodes[parent].firstEdge });
+		m_nodes[parent].firstEdge = static_cast<uint32_t>(m_edges.size() - 1);
+		return child;
+	}
+
+	// Moves that have been played from a position, most recent first
+	template <size_t N>
+	void continuations(NodeId id, common::FastVector<moves::Move, N> &moves) const {
+		for (uint32_t edge = m_nodes[id].firstEdge; edge != NONE && moves.size() < N; edge = m_edges[edge].nextEdge) {
+			if (m_edges[edge].move != moves::Move::EMPTY) {
+				moves.push_back(m_edges[edge].move);
+			}
+		}
+	}
+
+	// Keeps the root, the nodes of the line and the continuations played from them, everything further away is dropped
+	// Returns the new id of every old node, NONE for the dropped ones
+	std::vector<NodeId> prune(const std::vector<NodeId> &line) {
+		std::vector<bool> onLine(m_nodes.size(), false);
+		for (const NodeId id : line) {
+			onLine[id] = true;
+		}
+
+		std::vector<NodeId> remap(m_nodes.size(), NONE);
+		std::vector<Node> nodes;
+		auto keep = [&](NodeId id) {
+			if (remap[id] == NONE) {
+				remap[id] = static_cast<NodeId>(nodes.size());
+				nodes.push_back(std::move(m_nodes[id]));
+				nodes.back().firstEdge = NONE;
+			}
+		};
+
+		keep(m_root);
+		for (const NodeId id : line) {
+			keep(id);
+		}
+
+		std::vector<Edge> edges;
+		for (NodeId id = 0; id < m_nodes.size(); ++id) {
+			if (!onLine[id]) {
+				continue;
+			}
+
+			// Walked oldest first so every parent keeps its most recent continuation first
+			std::vector<uint32_t> continuations;
+			for (uint32_t edge = m_nodes[id].firstEdge; edge != NONE; edge = m_edges[edge].nextEdge) {
+				continuations.push_back(edge);
+			}
+			for (auto edge = continuations.rbegin(); edge != continuations.rend(); ++edge) {
+				keep(m_edges[*edge].node);
+				edges.push_back(Edge{ m_edges[*edge].move, m_edges[*edge].wall, remap[m_edges[*edge].node], nodes[remap[id]].firstEdge });
+				nodes[remap[id]].firstEdge = static_cast<uint32_t>(edges.size() - 1);
+			}
+		}
+
+		m_nodes = std::move(nodes);
+		m_edges = std::move(edges);
+		rehash(m_nodes.size() * 2);
+		m_root = remap[m_root];
+		return remap;
+	}
+
+private:
+	// Rebuilds the index with at least the given number of slots, kept at most half full
+	void rehash(size_t slots) {
+		size_t size = 16;
+		while (size < slots) {
+			size *= 2;
+		}
+
+		std::vector<NodeId> index(size, NONE);
+		for (NodeId id = 0; id < m_nodes.size(); ++id) {
+			size_t slot = m_nodes[id].hash & (size - 1);
+			while (index[slot] != NONE) {
+				slot = (slot + 1) & (size - 1);
+			}
+			index[slot] = id;
+		}
+		m_index = std::move(index);
+	}
+
+	NodeId m_root = NONE;
+	std::vector<Node> m_nodes;
+	std::vector<Edge> m_edges;
+	std::vector<NodeId> m_index; // Node of every hash, open addressed by the low bits of the hash
+};
+
+} //namespace phase4::engine::board
+
+#endif
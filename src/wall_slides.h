@@ -0,0 +1,144 @@
+#ifndef PHASE4_ENGINE_BOARD_WALL_SLIDES_H
+#define PHASE4_ENGINE_BOARD_WALL_SLIDES_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace phase4::engine::board {
+
+// Every single step slide of the walls worked out at compile time
+// Walls are a 2x2 block on even files and ranks keyed by its lowest square, a step moves it two files or ranks
+// Squares are raw square values so a slide is a mask and a shift, offsets are the same as FieldIndex::offset()
+class WallSlides {
+public:
+	struct Slide {
+		uint64_t from = 0; // Walls before the slide
+		uint64_t to = 0; // Walls after the slide, what was on these squares is pushed into from
+		int8_t offset = 0; // Raw square offset of the walls, the pushed squares move the other way
+	};
+
+	static constexpr std::array<int8_t, 4> OFFSETS = { 2, -2, 16, -16 };
+
+	// The slide of the walls with the lowest square by the offset, nothing when it leaves the board
+	static constexpr const Slide *find(size_t lowestWall, int32_t offset) {
+		if (lowestWall >= TABLE.size()) {
+			return nullptr;
+		}
+
+		for (size_t direction = 0; direction < OFFSETS.size(); ++direction) {
+			if (OFFSETS[direction] == offset) {
+				const Slide &slide = TABLE[lowestWall][direction];
+				return slide.to != 0 ? &slide : nullptr;
+			}
+		}
+		return nullptr;
+	}
+
+	// The single step that turns one wall position into another, nothing when there is none
+	static constexpr const Slide *between(uint64_t fromWalls, uint64_t toWalls) {
+		if (fromWalls == 0 || toWalls == 0) {
+			return nullptr;
+		}
+
+		for (const Slide &slide : TABLE[lowestSquare(fromWalls)]) {
+			if (slide.from == fromWalls && slide.to == toWalls) {
+				return &slide;
+			}
+		}
+		return nullptr;
+	}
+
+	// Where the content of every square came from when the walls slid in a straight line from one position to the other
+	// Returns false when no number of steps in one direction leads there
+	static constexpr bool origins(uint64_t fromWalls, uint64_t toWalls, std::array<uint8_t, 64> &origin) {
+		for (const int8_t offset : OFFSETS) {
+			for (size_t square = 0; square < origin.size(); ++square) {
+				origin[square] = static_cast<uint8_t>(square);
+			}
+
+			uint64_t walls = fromWalls;
+			while (walls != 0) {
+				const Slide *slide = find(lowestSquare(walls), offset);
+				if (!slide || slide->from != walls) {
+					break;
+				}
+
+				for (uint64_t pushed = slide->to; pushed != 0; pushed &= pushed - 1) {
+					const size_t square = lowestSquare(pushed);
+					origin[square - offset] = origin[square];
+				}
+
+				walls = slide->to;
+				if (walls == toWalls) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	// The bitboard after the slide, what was on the squares the walls moved onto is pushed into the ones they left
+	static constexpr uint64_t push(const Slide &slide, uint64_t bitboard) {
+		const uint64_t pushed = bitboard & slide.to;
+		return (bitboard & ~slide.to) | (slide.offset > 0 ? pushed >> slide.offset : pushed << -slide.offset);
+	}
+
+	// 64 when the bitboard is empty
+	static constexpr size_t lowestSquare(uint64_t bitboard) {
+#if defined(__GNUC__) || defined(__clang__)
+		return bitboard != 0 ? static_cast<size_t>(__builtin_ctzll(bitboard)) : 64;
+#else
+		size_t square = 0;
+		while ((bitboard & 1) == 0 && square < 64) {
+			bitboard >>= 1;
+			++square;
+		}
+		return square;
+#endif
+	}
+
+private:
+	using Table = std::array<std::array<Slide, OFFSETS.size()>, 64>;
+
+	static constexpr uint64_t block(size_t square) {
+		return (uint64_t(3) << square) | (uint64_t(3) << (square + 8));
+	}
+
+	static constexpr Table build() {
+		Table table = {};
+		for (size_t square = 0; square < 64; ++square) {
+			const size_t file = square % 8;
+			const size_t rank = square / 8;
+			if (file % 2 != 0 || rank % 2 != 0) {
+				continue;
+			}
+
+			for (size_t direction = 0; direction < OFFSETS.size(); ++direction) {
+				const int32_t offset = OFFSETS[direction];
+				const int32_t targetFile = int32_t(file) + (offset == 2 ? 2 : offset == -2 ? -2 : 0);
+				const int32_t targetRank = int32_t(rank) + (offset == 16 ? 2 : offset == -16 ? -2 : 0);
+				if (targetFile < 0 || targetFile > 6 || targetRank < 0 || targetRank > 6) {
+					continue;
+				}
+
+				Slide &slide = table[square][direction];
+				slide.from = block(square);
+				slide.to = block(size_t(targetFile + targetRank * 8));
+				slide.offset = static_cast<int8_t>(offset);
+			}
+		}
+		return table;
+	}
+
+	static const Table TABLE;
+};
+
+inline constexpr WallSlides::Table WallSlides::TABLE = WallSlides::build();
+
+static_assert(WallSlides::find(0, 2)->to == 0x0C0C && WallSlides::find(0, -2) == nullptr, "Walls slide two files without leaving the board");
+static_assert(WallSlides::push(*WallSlides::find(0, 2), 0x0804) == 0x0201, "Pushed squares move the other way");
+
+} //namespace phase4::engine::board
+
+#endif
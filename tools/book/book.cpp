@@ -0,0 +1,122 @@
+// Builds a position book from positions annotated with what is known about them
+//
+// Usage: book <input> <output>
+//
+// The input holds one position per line in the EPD style also used by perft:
+//   <fen> ;walls d4 ;freq 120 ;score 35 ;bm e2e4 d2d4
+// freq is how often the position was seen, score is in centipawns for the side to move
+// and bm lists up to four moves, best first. Lines of the same position are merged.
+
+#include <phase4/engine/board/position.h>
+#include <phase4/engine/board/position_moves.h>
+#include <phase4/engine/moves/move.h>
+
+#include "book.h"
+#include "epd.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace phase4::engine;
+
+namespace {
+
+// Moves that are not valid in the position are reported and left out
+bool parseMoves(const board::Position &position, const std::string &text, board::Book::Entry &entry, size_t lineNumber) {
+	moves::Moves validMoves;
+	board::PositionMoves::getValidMoves(position, validMoves);
+
+	std::istringstream stream(text);
+	std::string notation;
+	size_t count = 0;
+	bool valid = true;
+	while (stream >> notation) {
+		bool found = false;
+		for (size_t i = 0; i < validMoves.size() && !found; ++i) {
+			if (std::strcmp(validMoves[i].asUciNotation().data(), notation.c_str()) == 0) {
+				const char promotion = notation.size() > 4 ? notation[4] : '\0';
+				if (count < board::Book::MAX_MOVES) {
+					entry.moves[count++] = board::Book::encodeMove(validMoves[i].from(), validMoves[i].to(), promotion);
+				}
+				found = true;
+			}
+		}
+
+		if (!found) {
+			std::fprintf(stderr, "line %zu: invalid move %s\n", lineNumber, notation.c_str());
+			valid = false;
+		}
+	}
+	return valid;
+}
+
+} //namespace
+
+int main(int argc, char **argv) {
+	if (argc != 3) {
+		std::fprintf(stderr, "Usage: book <input> <output>\n");
+		return 2;
+	}
+
+	std::ifstream input(argv[1]);
+	if (!input) {
+		std::fprintf(stderr, "Could not open %s\n", argv[1]);
+		return 2;
+	}
+
+	std::vector<board::Book::Entry> entries;
+	size_t errors = 0;
+	size_t lineNumber = 0;
+	std::string text;
+	while (std::getline(input, text)) {
+		++lineNumber;
+		const std::optional<board::Epd::Line> line = board::Epd::parseLine(text);
+		if (!line) {
+			continue;
+		}
+
+		const std::optional<board::Position> position = board::Epd::toPosition(*line);
+		if (!position) {
+			std::fprintf(stderr, "line %zu: invalid position\n", lineNumber);
+			++errors;
+			continue;
+		}
+
+		board::Book::Entry entry;
+		entry.key = position->hash().get_raw_value();
+		entry.frequency = 1;
+		if (const std::string *frequency = line->operation("freq")) {
+			entry.frequency = static_cast<uint32_t>(std::strtoul(frequency->c_str(), nullptr, 10));
+		}
+		if (const std::string *score = line->operation("score")) {
+			entry.score = static_cast<int16_t>(std::strtol(score->c_str(), nullptr, 10));
+		}
+		if (const std::string *bestMoves = line->operation("bm")) {
+			errors += parseMoves(*position, *bestMoves, entry, lineNumber) ? 0 : 1;
+		}
+		entries.push_back(entry);
+	}
+
+	std::FILE *output = std::fopen(argv[2], "wb");
+	if (!output) {
+		std::fprintf(stderr, "Could not create %s\n", argv[2]);
+		return 2;
+	}
+
+	const size_t count = entries.size();
+	const bool written = board::Book::write(output, std::move(entries));
+	if (std::fclose(output) != 0 || !written) {
+		std::fprintf(stderr, "Could not write %s\n", argv[2]);
+		return 2;
+	}
+
+	std::printf("%zu positions read, %zu errors\n", count, errors);
+	return errors == 0 ? 0 : 1;
+}
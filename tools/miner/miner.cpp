@@ -0,0 +1,545 @@
+// Finds mate and tactic puzzles of the wall-slide variant in self-play games
+//
+// Usage: miner [options] <output>
+//   --games N         Self-play games to look through, defaults to 1000
+//   --input FILE      Look through the positions of an EPD file instead of playing games
+//   --threads N       Threads games are split across, defaults to the hardware concurrency
+//   --hash MB         Size of each table shared by the threads, defaults to 64
+//   --mate N          Longest mate searched for in moves of the side to move, defaults to 3
+//   --nodes N         Nodes a mate search may visit in one position before giving up, defaults to 200000
+//   --tactic-depth N  Depth of the search for tactics, 0 to only look for mates, defaults to 4
+//   --tactic-gain CP  Material the best move has to win over the static evaluation and the next best move, defaults to 300
+//   --min-ply N       Plies of a game played before its positions are considered, defaults to 8
+//   --seed N          Seed of the self-play games and their walls
+//
+// Games place the walls on a random square and are played by greedy capture players with random tie breaks.
+// Every position is searched for a mate in up to N moves with a single first move and no shorter mate,
+// failing that for a move that wins at least the tactic gain when the others do not.
+//
+// Puzzles are written as one EPD line each, in the style read by book and perft:
+//   <fen> ;walls d4 ;bm d1h5 ;pv d1h5 g7g6 h5f7 ;mate 2
+//   <fen> ;bm c4f7 ;score 320
+
+#include <phase4/engine/board/position.h>
+#include <phase4/engine/board/position_moves.h>
+#include <phase4/engine/board/session.h>
+#include <phase4/engine/fen/position_to_fen.h>
+#include <phase4/engine/moves/move.h>
+
+#include "epd.h"
+#include "players.h"
+#include "position_key.h"
+#include "position_view.h"
+#include "search.h"
+#include "transposition_table.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace phase4::engine;
+
+namespace {
+
+struct Options {
+	size_t games = 1000;
+	std::string input;
+	size_t threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t hashMegabytes = 64;
+	size_t mate = 3;
+	uint64_t nodes = 200000;
+	int32_t tacticDepth = 4;
+	int32_t tacticGain = 300;
+	size_t minPly = 8;
+	uint64_t seed = 0;
+	std::string output;
+};
+
+struct Puzzle {
+	std::vector<moves::Move> solution; // The first move then the best defence and the answers to it
+	size_t mate = 0; // Moves to mate, 0 for a tactic
+	int32_t score = 0;
+};
+
+// Keys of the positions already considered, shared by the threads without a lock
+// A key that finds no free slot within PROBES slots is reported as new, so a full table only repeats some searches
+class SeenPositions {
+public:
+	static constexpr size_t PROBES = 16;
+	static constexpr size_t MAX_SLOTS = size_t(1) << 24;
+
+	// Sized for the positions expected, up to MAX_SLOTS
+	explicit SeenPositions(size_t positions) {
+		size_t size = 1024;
+		while (size < positions * 2 && size < MAX_SLOTS) {
+			size *= 2;
+		}
+		m_slots = std::make_unique<std::atomic<uint64_t>[]>(size);
+		m_mask = size - 1;
+	}
+
+	// Returns false when the key was inserted before
+	bool insert(uint64_t key) {
+		key |= key == 0 ? 1 : 0; // 0 marks an empty slot
+		for (size_t i = 0; i < PROBES; ++i) {
+			std::atomic<uint64_t> &slot = m_slots[(key + i) & m_mask];
+			uint64_t stored = slot.load(std::memory_order_relaxed);
+			if (stored == 0 && slot.compare_exchange_strong(stored, key, std::memory_order_relaxed)) {
+				return true;
+			}
+			if (stored == key) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+private:
+	std::unique_ptr<std::atomic<uint64_t>[]> m_slots;
+	size_t m_mask = 0;
+};
+
+// Proves mates by trying every move of the attacker against every defence, proofs are kept in a table shared by the threads
+//
+// The table holds the mate distance of the attacker as EXACT entries and the distance a mate was ruled out to as UPPER entries
+class MateSearch {
+public:
+	MateSearch(board::TranspositionTable &table, uint64_t nodeBudget) :
+			m_table(table), m_nodeBudget(nodeBudget) {
+	}
+
+	// The shortest mate of the side to move up to the given moves, nothing when there is none or the budget ran out
+	std::optional<Puzzle> find(const board::Position &position, size_t maxMoves) {
+		m_session.setPosition(position);
+		m_nodes = 0;
+		m_aborted = false;
+
+		moves::Moves validMoves;
+		board::PositionMoves::getValidMoves(position, validMoves);
+		for (size_t moves = 1; moves <= maxMoves; ++moves) {
+			// A puzzle has a single solution, every mating first move is counted
+			std::optional<moves::Move> first;
+			size_t solutions = 0;
+			for (size_t i = 0; i < validMoves.size() && solutions < 2; ++i) {
+				m_session.makeMove(validMoves[i]);
+				const bool mated = defenderLost(moves);
+				m_session.undoMove(validMoves[i]);
+
+				if (m_aborted) {
+					return {};
+				}
+				if (mated) {
+					first = validMoves[i];
+					++solutions;
+				}
+			}
+
+			if (solutions > 1) {
+				return {};
+			}
+			if (solutions == 1) {
+				Puzzle puzzle;
+				puzzle.mate = moves;
+				principalVariation(*first, moves, puzzle.solution);
+				return m_aborted ? std::nullopt : std::optional<Puzzle>(puzzle);
+			}
+		}
+		return {};
+	}
+
+private:
+	bool overBudget() {
+		m_aborted = m_aborted || ++m_nodes > m_nodeBudget;
+		return m_aborted;
+	}
+
+	// Whether the side to move mates within the moves, the mating move is written when asked for
+	bool mates(size_t moves, moves::Move *mate) {
+		if (overBudget()) {
+			return false;
+		}
+
+		const uint64_t key = board::PositionKey::of(m_session.position());
+		board::TranspositionTable::Entry entry;
+		if (!mate && m_table.probe(key, entry)) {
+			if (entry.bound == board::TranspositionTable::EXACT && entry.depth <= moves) {
+				return true;
+			}
+			if (entry.bound == board::TranspositionTable::UPPER && entry.depth >= moves) {
+				return false;
+			}
+		}
+
+		moves::Moves validMoves;
+		board::PositionMoves::getValidMoves(m_session.position(), validMoves);
+		const common::PieceColor defender = m_session.position().colorToMove().invert();
+		for (size_t i = 0; i < validMoves.size(); ++i) {
+			m_session.makeMove(validMoves[i]);
+			// The last move has to give check to mate
+			const bool found = (moves > 1 || m_session.position().isKingChecked(defender)) && defenderLost(moves);
+			m_session.undoMove(validMoves[i]);
+
+			if (m_aborted) {
+				return false;
+			}
+			if (found) {
+				board::TranspositionTable::Entry stored;
+				stored.move = board::Search::encode(validMoves[i]);
+				stored.depth = static_cast<uint8_t>(moves);
+				stored.bound = board::TranspositionTable::EXACT;
+				m_table.store(key, stored);
+				if (mate) {
+					*mate = validMoves[i];
+				}
+				return true;
+			}
+		}
+
+		board::TranspositionTable::Entry stored;
+		stored.depth = static_cast<uint8_t>(moves);
+		stored.bound = board::TranspositionTable::UPPER;
+		m_table.store(key, stored);
+		return false;
+	}
+
+	// Whether the side to move is mated before the attacker used up its moves, one was just played
+	bool defenderLost(size_t moves) {
+		const board::Position &position = m_session.position();
+		moves::Moves validMoves;
+		board::PositionMoves::getValidMoves(position, validMoves);
+		if (validMoves.size() == 0) {
+			return position.isKingChecked(position.colorToMove()); // Stalemate is no win
+		}
+		if (moves == 1) {
+			return false;
+		}
+
+		for (size_t i = 0; i < validMoves.size(); ++i) {
+			m_session.makeMove(validMoves[i]);
+			const bool lost = mates(moves - 1, nullptr);
+			m_session.undoMove(validMoves[i]);
+
+			if (!lost) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Follows the mate with the defence that holds out the longest, the tree is in the table so this is cheap
+	void principalVariation(moves::Move first, size_t moves, std::vector<moves::Move> &line) {
+		std::vector<moves::Move> played = { first };
+		m_session.makeMove(first);
+		line.push_back(first);
+
+		for (size_t remaining = moves - 1; remaining > 0 && !m_aborted; --remaining) {
+			moves::Moves defences;
+			board::PositionMoves::getValidMoves(m_session.position(), defences);
+
+			std::optional<moves::Move> longest;
+			size_t longestMate = 0;
+			for (size_t i = 0; i < defences.size(); ++i) {
+				m_session.makeMove(defences[i]);
+				size_t mateIn = 1;
+				while (mateIn < remaining && !mates(mateIn, nullptr) && !m_aborted) {
+					++mateIn;
+				}
+				m_session.undoMove(defences[i]);
+
+				if (mateIn > longestMate) {
+					longest = defences[i];
+					longestMate = mateIn;
+				}
+			}
+			if (!longest) {
+				break;
+			}
+
+			m_session.makeMove(*longest);
+			played.push_back(*longest);
+			line.push_back(*longest);
+
+			moves::Move answer;
+			if (!mates(longestMate, &answer)) {
+				break;
+			}
+			m_session.makeMove(answer);
+			played.push_back(answer);
+			line.push_back(answer);
+			remaining = longestMate;
+		}
+
+		for (auto move = played.rbegin(); move != played.rend(); ++move) {
+			m_session.undoMove(*move);
+		}
+	}
+
+	board::TranspositionTable &m_table;
+	board::Session m_session;
+	uint64_t m_nodeBudget;
+	uint64_t m_nodes = 0;
+	bool m_aborted = false;
+};
+
+// A move that wins material the other moves do not, checked by searching every move with the shared table
+std::optional<Puzzle> findTactic(board::Search &search, const board::Position &position, int32_t depth, int32_t gain) {
+	const int32_t standing = board::Search::evaluate(position);
+	if (std::abs(standing) >= gain) {
+		return {}; // Already decided, winning more is no puzzle
+	}
+
+	board::Search::Limits limits;
+	limits.maxDepth = depth;
+	const board::Search::Result result = search.run(position, limits);
+	if (!result.move || result.score - standing < gain || result.score >= board::Search::MATE - int32_t(board::Search::MAX_PLY)) {
+		return {};
+	}
+
+	moves::Moves validMoves;
+	board::PositionMoves::getValidMoves(position, validMoves);
+	board::Session session;
+	session.setPosition(position);
+	limits.maxDepth = std::max(depth - 1, 1);
+	for (size_t i = 0; i < validMoves.size(); ++i) {
+		if (board::Search::encode(validMoves[i]) == board::Search::encode(*result.move)) {
+			continue;
+		}
+
+		session.makeMove(validMoves[i]);
+		const int32_t score = -search.run(session.position(), limits).score;
+		session.undoMove(validMoves[i]);
+		if (result.score - score < gain) {
+			return {}; // Another move does about as well
+		}
+	}
+
+	Puzzle puzzle;
+	puzzle.solution.push_back(*result.move);
+	puzzle.score = result.score;
+	return puzzle;
+}
+
+std::string formatPuzzle(const board::Position &position, const Puzzle &puzzle) {
+	std::string line = fen::PositionToFen::encode(position);
+	if (position.walls().get_raw_value() != 0) {
+		line += " ;walls ";
+		line += common::Square(position.walls()).asBuffer().data();
+	}
+
+	line += " ;bm ";
+	line += puzzle.solution.front().asUciNotation().data();
+	if (puzzle.mate != 0) {
+		line += " ;pv";
+		for (const moves::Move move : puzzle.solution) {
+			line += " ";
+			line += move.asUciNotation().data();
+		}
+		line += " ;mate " + std::to_string(puzzle.mate);
+	} else {
+		line += " ;score " + std::to_string(puzzle.score);
+	}
+	return line;
+}
+
+class Miner {
+public:
+	static constexpr size_t MAX_GAME_PLIES = 200;
+
+	explicit Miner(const Options &options, std::FILE *output) :
+			m_options(options), m_output(output), m_mateTable(options.hashMegabytes * 1024 * 1024), m_searchTable(options.hashMegabytes * 1024 * 1024) {
+	}
+
+	// Splits the games or positions across threads, each thread plays and searches whole games on its own
+	void run(const std::vector<board::Position> &positions) {
+		std::atomic<size_t> next = 0;
+		const size_t count = positions.empty() ? m_options.games : positions.size();
+		m_seen = std::make_unique<SeenPositions>(positions.empty() ? count * MAX_GAME_PLIES : count);
+
+		std::vector<std::thread> workers;
+		for (size_t i = 0; i < std::max<size_t>(m_options.threads, 1); ++i) {
+			workers.emplace_back([&]() {
+				MateSearch mateSearch(m_mateTable, m_options.nodes);
+				std::unique_ptr<board::Search> search = std::make_unique<board::Search>(m_searchTable);
+				for (size_t index = next++; index < count; index = next++) {
+					if (positions.empty()) {
+						playGame(index, mateSearch, *search);
+					} else {
+						consider(positions[index], mateSearch, *search);
+					}
+				}
+			});
+		}
+
+		for (std::thread &worker : workers) {
+			worker.join();
+		}
+	}
+
+	size_t positions() const {
+		return m_positions;
+	}
+
+	size_t mates() const {
+		return m_mates;
+	}
+
+	size_t tactics() const {
+		return m_tactics;
+	}
+
+private:
+	void playGame(size_t index, MateSearch &mateSearch, board::Search &search) {
+		board::Random random(m_options.seed ^ (uint64_t(index) * 0xD1B54A32D192ED03ull));
+		board::GreedyCapturePlayer player;
+
+		std::unique_ptr<board::PositionView> game = std::make_unique<board::PositionView>();
+		const size_t first = random.below(64);
+		for (size_t i = 0; i < 64 && game->size() == 1; ++i) {
+			game->setWalls(common::Square((first + i) % 64));
+		}
+
+		for (size_t ply = 0; ply < MAX_GAME_PLIES && !game->isThreefoldRepetition(); ++ply) {
+			if (ply >= m_options.minPly) {
+				consider(game->current(), mateSearch, search);
+			}
+
+			std::optional<moves::Move> move = player.choose(*game, random);
+			if (!move || !game->makeMove(*move)) {
+				break;
+			}
+		}
+	}
+
+	void consider(const board::Position &position, MateSearch &mateSearch, board::Search &search) {
+		++m_positions;
+		// Games often reach the same positions, each is searched once
+		if (!m_seen->insert(board::PositionKey::of(position))) {
+			return;
+		}
+
+		std::optional<Puzzle> puzzle = mateSearch.find(position, m_options.mate);
+		if (puzzle) {
+			++m_mates;
+		} else if (m_options.tacticDepth > 0) {
+			puzzle = findTactic(search, position, m_options.tacticDepth, m_options.tacticGain);
+			m_tactics += puzzle ? 1 : 0;
+		}
+
+		if (puzzle) {
+			const std::string line = formatPuzzle(position, *puzzle);
+			std::lock_guard<std::mutex> lock(m_mutex);
+			std::fprintf(m_output, "%s\n", line.c_str());
+		}
+	}
+
+	const Options &m_options;
+	std::FILE *m_output;
+	board::TranspositionTable m_mateTable;
+	board::TranspositionTable m_searchTable;
+
+	std::mutex m_mutex; // Guards the output
+	std::unique_ptr<SeenPositions> m_seen;
+	std::atomic<size_t> m_positions = 0;
+	std::atomic<size_t> m_mates = 0;
+	std::atomic<size_t> m_tactics = 0;
+};
+
+void usage() {
+	std::fprintf(stderr, "Usage: miner [--games N] [--input FILE] [--threads N] [--hash MB] [--mate N] [--nodes N] [--tactic-depth N] [--tactic-gain CP] [--min-ply N] [--seed N] <output>\n");
+}
+
+} //namespace
+
+int main(int argc, char **argv) {
+	Options options;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (arg == "--games" && hasValue) {
+			options.games = std::strtoull(argv[++i], nullptr, 10);
+		} else if (arg == "--input" && hasValue) {
+			options.input = argv[++i];
+		} else if (arg == "--threads" && hasValue) {
+			options.threads = std::strtoull(argv[++i], nullptr, 10);
+		} else if (arg == "--hash" && hasValue) {
+			options.hashMegabytes = std::max<size_t>(std::strtoull(argv[++i], nullptr, 10), 1);
+		} else if (arg == "--mate" && hasValue) {
+			options.mate = std::clamp<size_t>(std::strtoull(argv[++i], nullptr, 10), 1, 16);
+		} else if (arg == "--nodes" && hasValue) {
+			options.nodes = std::strtoull(argv[++i], nullptr, 10);
+		} else if (arg == "--tactic-depth" && hasValue) {
+			options.tacticDepth = std::clamp<int32_t>(std::atoi(argv[++i]), 0, board::Search::MAX_PLY - 1);
+		} else if (arg == "--tactic-gain" && hasValue) {
+			options.tacticGain = std::atoi(argv[++i]);
+		} else if (arg == "--min-ply" && hasValue) {
+			options.minPly = std::strtoull(argv[++i], nullptr, 10);
+		} else if (arg == "--seed" && hasValue) {
+			options.seed = std::strtoull(argv[++i], nullptr, 10);
+		} else if (arg[0] != '-' && options.output.empty()) {
+			options.output = arg;
+		} else {
+			usage();
+			return 2;
+		}
+	}
+
+	if (options.output.empty()) {
+		usage();
+		return 2;
+	}
+
+	std::vector<board::Position> positions;
+	if (!options.input.empty()) {
+		std::ifstream input(options.input);
+		if (!input) {
+			std::fprintf(stderr, "Could not open %s\n", options.input.c_str());
+			return 2;
+		}
+
+		size_t lineNumber = 0;
+		std::string text;
+		while (std::getline(input, text)) {
+			++lineNumber;
+			const std::optional<board::Epd::Line> line = board::Epd::parseLine(text);
+			if (!line) {
+				continue;
+			}
+
+			const std::optional<board::Position> position = board::Epd::toPosition(*line);
+			if (!position) {
+				std::fprintf(stderr, "line %zu: invalid position\n", lineNumber);
+				continue;
+			}
+			positions.push_back(*position);
+		}
+	}
+
+	std::FILE *output = std::fopen(options.output.c_str(), "w");
+	if (!output) {
+		std::fprintf(stderr, "Could not create %s\n", options.output.c_str());
+		return 2;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	Miner miner(options, output);
+	miner.run(positions);
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (std::fclose(output) != 0) {
+		std::fprintf(stderr, "Could not write %s\n", options.output.c_str());
+		return 2;
+	}
+
+	std::printf("%zu positions, %zu mates, %zu tactics in %.3fs\n", miner.positions(), miner.mates(), miner.tactics(), seconds);
+	return 0;
+}
@@ -0,0 +1,510 @@
+// Counts the leaf nodes of the move tree to verify and benchmark move generation
+//
+// Usage: perft [options] [file]
+//   --depth N    Deepest ply to count, defaults to the deepest expected value
+//   --threads N  Threads the root moves are split across, defaults to the hardware concurrency
+//   --hash MB    Size of the table shared by threads to reuse counts of transpositions
+//   --slides     Also count leaf moves that slid the walls, disables bulk counting and the table
+//   --fen FEN    Count a single position instead of the file
+//   --walls SQ   Walls placed on the single position
+//   --view       Also walk every position through PositionView, see ViewPerft
+//   --hashes     Compares the hash of every position with one calculated from scratch, disables bulk counting and the table
+//   --update     Adds the counts of positions that have none to the file
+//
+// The file holds one position per line in the EPD style used by perft suites:
+//   <fen> ;walls d4 ;D1 20 ;D2 400
+// The walls field is optional and D<n> gives the expected nodes at depth n
+// Positions with walls have no published counts, they fail without counts of their own until --update records them
+// Positions without counts are always walked through PositionView as well, so they fail on any difference
+
+#include <phase4/engine/board/position.h>
+#include <phase4/engine/board/position_moves.h>
+#include <phase4/engine/board/session.h>
+#include <phase4/engine/board/zobrist_hashing.h>
+#include <phase4/engine/common/field_index.h>
+#include <phase4/engine/moves/move.h>
+
+#include "epd.h"
+#include "position_key.h"
+#include "position_view.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace phase4::engine;
+
+namespace {
+
+struct Counts {
+	uint64_t nodes = 0;
+	uint64_t slides = 0; // Leaf moves whose result slid the walls
+
+	Counts &operator+=(const Counts &other) {
+		nodes += other.nodes;
+		slides += other.slides;
+		return *this;
+	}
+};
+
+// Subtree counts by position and depth, shared without locks by checking the key against the data
+class PerftTable {
+public:
+	explicit PerftTable(size_t megabytes) {
+		size_t size = 1;
+		while (size * 2 * sizeof(Entry) <= megabytes * 1024 * 1024) {
+			size *= 2;
+		}
+		m_entries = std::vector<Entry>(megabytes == 0 ? 0 : size);
+	}
+
+	bool enabled() const {
+		return !m_entries.empty();
+	}
+
+	bool find(uint64_t key, size_t depth, uint64_t &nodes) const {
+		const Entry &entry = m_entries[key & (m_entries.size() - 1)];
+		const uint64_t data = entry.data.load(std::memory_order_relaxed);
+		if ((entry.key.load(std::memory_order_relaxed) ^ data) != key || (data & 0xFF) != depth) {
+			return false;
+		}
+
+		nodes = data >> 8;
+		return true;
+	}
+
+	void store(uint64_t key, size_t depth, uint64_t nodes) {
+		Entry &entry = m_entries[key & (m_entries.size() - 1)];
+		const uint64_t data = (nodes << 8) | depth;
+		entry.key.store(key ^ data, std::memory_order_relaxed);
+		entry.data.store(data, std::memory_order_relaxed);
+	}
+
+private:
+	struct Entry {
+		std::atomic<uint64_t> key = 0;
+		std::atomic<uint64_t> data = 0;
+	};
+
+	std::vector<Entry> m_entries;
+};
+
+class Perft {
+public:
+	Perft(size_t hashMegabytes, bool countSlides, bool checkHashes) :
+			m_table(countSlides || checkHashes ? 0 : hashMegabytes), m_countSlides(countSlides), m_checkHashes(checkHashes) {
+	}
+
+	// Positions whose incrementally updated hash differed from the calculated one, only counted with checkHashes
+	uint64_t hashMismatches() const {
+		return m_hashMismatches.load(std::memory_order_relaxed);
+	}
+
+	// Splits the root moves across threads, each thread walks whole subtrees with its own session
+	Counts run(const board::Position &position, size_t depth, size_t threads) {
+		if (depth == 0) {
+			Counts counts;
+			counts.nodes = 1;
+			return counts;
+		}
+
+		moves::Moves rootMoves;
+		board::PositionMoves::getValidMoves(position, rootMoves);
+
+		std::atomic<size_t> next = 0;
+		std::mutex mutex;
+		Counts total;
+
+		std::vector<std::thread> workers;
+		for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i) {
+			workers.emplace_back([&]() {
+				board::Session session;
+				session.setPosition(position);
+
+				Counts counts;
+				for (size_t index = next++; index < rootMoves.size(); index = next++) {
+					const moves::Result &result = session.makeMove(rootMoves[index]);
+					checkHash(session.position());
+					if (depth == 1) {
+						counts.nodes += 1;
+						counts.slides += slid(result) ? 1 : 0;
+					} else {
+						counts += search(session, depth - 1);
+					}
+					session.undoMove(rootMoves[index]);
+				}
+
+				std::lock_guard<std::mutex> lock(mutex);
+				total += counts;
+			});
+		}
+
+		for (std::thread &worker : workers) {
+			worker.join();
+		}
+		return total;
+	}
+
+private:
+	static bool slid(const moves::Result &result) {
+		return result.slide && *result.slide != common::FieldIndex::ZERO;
+	}
+
+	Counts search(board::Session &session, size_t depth) {
+		Counts counts;
+
+		const uint64_t key = m_table.enabled() ? board::PositionKey::of(session.position()) : 0;
+		if (m_table.enabled() && depth > 1 && m_table.find(key, depth, counts.nodes)) {
+			return counts;
+		}
+
+		moves::Moves validMoves;
+		board::PositionMoves::getValidMoves(session.position(), validMoves);
+
+		// The moves at the last ply do not need to be made unless their results are counted
+		if (depth == 1 && !m_countSlides && !m_checkHashes) {
+			counts.nodes = validMoves.size();
+			return counts;
+		}
+
+		for (size_t i = 0; i < validMoves.size(); ++i) {
+			const moves::Result &result = session.makeMove(validMoves[i]);
+			checkHash(session.position());
+			if (depth == 1) {
+				counts.nodes += 1;
+				counts.slides += slid(result) ? 1 : 0;
+			} else {
+				counts += search(session, depth - 1);
+			}
+			session.undoMove(validMoves[i]);
+		}
+
+		if (m_table.enabled()) {
+			m_table.store(key, depth, counts.nodes);
+		}
+		return counts;
+	}
+
+	// The table and repetition keys rely on the hash the engine updates with every move and slide
+	void checkHash(const board::Position &position) {
+		if (m_checkHashes && position.hash() != board::ZobristHashing::calculateHash(position)) {
+			m_hashMismatches.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	PerftTable m_table;
+	bool m_countSlides;
+	bool m_checkHashes;
+	std::atomic<uint64_t> m_hashMismatches = 0;
+};
+
+// Walks the tree through PositionView::makeMove and undo, which update the moves after each ply and share them through MoveCache
+// Every position and its moves are compared against a session and the engine's own generator
+class ViewPerft {
+public:
+	struct Result {
+		Counts counts;
+		uint64_t mismatches = 0;
+	};
+
+	Result run(const board::Position &position, size_t depth, size_t threads) {
+		// Differences have to show up here rather than being fixed quietly
+		board::PositionView::setCheckUpdatedMoves(false);
+
+		moves::Moves rootMoves;
+		board::PositionMoves::getValidMoves(position, rootMoves);
+
+		std::atomic<size_t> next = 0;
+		std::mutex mutex;
+		Result total;
+
+		std::vector<std::thread> workers;
+		for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i) {
+			workers.emplace_back([&, i]() {
+				std::unique_ptr<board::PositionView> view = std::make_unique<board::PositionView>();
+				view->reset(position);
+				board::Session session;
+				session.setPosition(position);
+
+				Result result;
+				if (i == 0) {
+					compare(*view, session.position(), result);
+				}
+				for (size_t index = next++; depth > 0 && index < rootMoves.size(); index = next++) {
+					walk(*view, session, rootMoves[index], depth, result);
+				}
+
+				std::lock_guard<std::mutex> lock(mutex);
+				total.counts += result.counts;
+				total.mismatches += result.mismatches;
+			});
+		}
+
+		for (std::thread &worker : workers) {
+			worker.join();
+		}
+
+		if (depth == 0) {
+			total.counts.nodes = 1;
+		}
+		return total;
+	}
+
+private:
+	static void walk(board::PositionView &view, board::Session &session, moves::Move move, size_t depth, Result &result) {
+		moves::Move played = move;
+		if (!view.makeMove(played)) {
+			++result.mismatches;
+			return;
+		}
+		session.makeMove(move);
+		compare(view, session.position(), result);
+
+		if (depth == 1) {
+			result.counts.nodes += 1;
+		} else {
+			moves::Moves validMoves;
+			board::PositionMoves::getValidMoves(session.position(), validMoves);
+			for (size_t i = 0; i < validMoves.size(); ++i) {
+				walk(view, session, validMoves[i], depth - 1, result);
+			}
+		}
+
+		view.undo();
+		session.undoMove(move);
+	}
+
+	static void compare(const board::PositionView &view, const board::Position &position, Result &result) {
+		const board::Position &viewed = view.current();
+		bool matches = viewed.hash() == position.hash() && viewed.occupancySummary() == position.occupancySummary() &&
+				viewed.walls() == position.walls() && viewed.colorToMove() == position.colorToMove();
+
+		moves::Moves expected;
+		board::PositionMoves::getValidMoves(position, expected);
+		const moves::Moves &validMoves = view.validMoves();
+		matches = matches && validMoves.size() == expected.size();
+		for (size_t i = 0; matches && i < expected.size(); ++i) {
+			matches = std::find(validMoves.begin(), validMoves.end(), expected[i]) != validMoves.end();
+		}
+
+		if (!matches) {
+			++result.mismatches;
+		}
+	}
+};
+
+struct Entry {
+	board::Epd::Line line;
+	std::map<size_t, uint64_t> expected; // Nodes by depth
+};
+
+std::optional<Entry> parseEntry(const std::string &text) {
+	std::optional<board::Epd::Line> line = board::Epd::parseLine(text);
+	if (!line) {
+		return {};
+	}
+
+	Entry entry;
+	entry.line = *line;
+	for (const auto &operation : entry.line.operations) {
+		if (operation.first.size() > 1 && operation.first[0] == 'D') {
+			entry.expected[std::strtoull(operation.first.c_str() + 1, nullptr, 10)] = std::strtoull(operation.second.c_str(), nullptr, 10);
+		}
+	}
+	return entry;
+}
+
+void usage() {
+	std::fprintf(stderr, "Usage: perft [--depth N] [--threads N] [--hash MB] [--slides] [--fen FEN] [--walls SQ] [--view] [--hashes] [--update] [file]\n");
+}
+
+// Appends the counts to the lines of positions that had none, every other line is kept as it was
+bool updateFile(const std::string &path, const std::map<std::string, std::map<size_t, uint64_t>> &counts) {
+	std::ifstream file(path);
+	std::vector<std::string> lines;
+	std::string line;
+	while (std::getline(file, line)) {
+		const auto found = counts.find(line);
+		if (found != counts.end()) {
+			for (const auto &[ply, nodes] : found->second) {
+				line += " ;D" + std::to_string(ply) + " " + std::to_string(nodes);
+			}
+		}
+		lines.push_back(line);
+	}
+	file.close();
+
+	std::ofstream out(path, std::ios::trunc);
+	for (const std::string &text : lines) {
+		out << text << "\n";
+	}
+	return static_cast<bool>(out);
+}
+
+} //namespace
+
+int main(int argc, char **argv) {
+	size_t depth = 0;
+	size_t threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t hashMegabytes = 0;
+	bool countSlides = false;
+	bool walkView = false;
+	bool checkHashes = false;
+	bool update = false;
+	std::optional<Entry> single;
+	std::string walls;
+	std::string path = "tools/perft/perft.epd";
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (arg == "--depth" && hasValue) {
+			depth = std::strtoull(argv[++i], nullptr, 10);
+		} else if (arg == "--threads" && hasValue) {
+			threads = std::strtoull(argv[++i], nullptr, 10);
+		} else if (arg == "--hash" && hasValue) {
+			hashMegabytes = std::strtoull(argv[++i], nullptr, 10);
+		} else if (arg == "--slides") {
+			countSlides = true;
+		} else if (arg == "--fen" && hasValue) {
+			single = parseEntry(argv[++i]);
+			if (!single) {
+				usage();
+				return 2;
+			}
+		} else if (arg == "--walls" && hasValue) {
+			walls = argv[++i];
+		} else if (arg == "--view") {
+			walkView = true;
+		} else if (arg == "--hashes") {
+			checkHashes = true;
+		} else if (arg == "--update") {
+			update = true;
+		} else if (arg[0] != '-') {
+			path = arg;
+		} else {
+			usage();
+			return 2;
+		}
+	}
+
+	std::vector<Entry> entries;
+	std::vector<std::string> texts; // Line of the file each entry was read from
+	if (single) {
+		if (!walls.empty()) {
+			single->line.operations.emplace_back("walls", walls);
+		}
+		entries.push_back(*single);
+	} else {
+		std::ifstream file(path);
+		if (!file) {
+			std::fprintf(stderr, "Could not open %s\n", path.c_str());
+			return 2;
+		}
+
+		std::string line;
+		while (std::getline(file, line)) {
+			const std::optional<Entry> entry = parseEntry(line);
+			if (entry) {
+				entries.push_back(*entry);
+				texts.push_back(line);
+			}
+		}
+	}
+
+	Perft perft(hashMegabytes, countSlides, checkHashes);
+	ViewPerft viewPerft;
+	std::map<std::string, std::map<size_t, uint64_t>> generated; // Counts of lines that had none, by line
+	size_t failures = 0;
+	uint64_t totalNodes = 0;
+	double totalSeconds = 0;
+
+	for (size_t index = 0; index < entries.size(); ++index) {
+		const Entry &entry = entries[index];
+		const std::optional<board::Position> position = board::Epd::toPosition(entry.line);
+		const std::string *wall = entry.line.operation("walls");
+		if (!position) {
+			std::printf("%s: invalid position\n", entry.line.fen.c_str());
+			++failures;
+			continue;
+		}
+
+		std::printf("%s%s%s\n", entry.line.fen.c_str(), wall ? " walls " : "", wall ? wall->c_str() : "");
+
+		// Wall slides are only checked against counts recorded from the engine, a line without them checks nothing
+		if (wall && entry.expected.empty() && !update && !single) {
+			std::printf("  no expected counts, run with --update to record them FAILED\n");
+			++failures;
+		}
+
+		const size_t maxDepth = depth != 0 ? depth : (entry.expected.empty() ? 4 : entry.expected.rbegin()->first);
+		for (size_t ply = 1; ply <= maxDepth; ++ply) {
+			const uint64_t hashMismatches = perft.hashMismatches();
+			const auto start = std::chrono::steady_clock::now();
+			const Counts counts = perft.run(*position, ply, threads);
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			totalNodes += counts.nodes;
+			totalSeconds += seconds;
+
+			const auto expected = entry.expected.find(ply);
+			const char *status = "";
+			if (expected != entry.expected.end()) {
+				status = expected->second == counts.nodes ? "ok" : "FAILED";
+				failures += expected->second == counts.nodes ? 0 : 1;
+			}
+
+			std::printf("  depth %2zu %14llu nodes", ply, static_cast<unsigned long long>(counts.nodes));
+			if (countSlides) {
+				std::printf(" %12llu slides", static_cast<unsigned long long>(counts.slides));
+			}
+			std::printf(" %9.3fs %12.0f nps %s", seconds, seconds > 0 ? counts.nodes / seconds : 0.0, status);
+			if (expected != entry.expected.end() && expected->second != counts.nodes) {
+				std::printf(" (expected %llu)", static_cast<unsigned long long>(expected->second));
+			}
+			std::printf("\n");
+
+			if (checkHashes) {
+				const uint64_t differences = perft.hashMismatches() - hashMismatches;
+				failures += differences == 0 ? 0 : 1;
+				std::printf("  hash  %2zu %14llu differences %s\n", ply, static_cast<unsigned long long>(differences), differences == 0 ? "ok" : "FAILED");
+			}
+
+			bool viewMatches = true;
+			if (walkView || entry.expected.empty()) {
+				const ViewPerft::Result walked = viewPerft.run(*position, ply, threads);
+				viewMatches = walked.mismatches == 0 && walked.counts.nodes == counts.nodes;
+				failures += viewMatches ? 0 : 1;
+				std::printf("  view  %2zu %14llu nodes %12llu differences %s\n", ply, static_cast<unsigned long long>(walked.counts.nodes),
+						static_cast<unsigned long long>(walked.mismatches), viewMatches ? "ok" : "FAILED");
+			}
+
+			// Counts are only recorded when both walks agree on them
+			if (update && viewMatches && entry.expected.empty() && index < texts.size()) {
+				generated[texts[index]][ply] = counts.nodes;
+			}
+		}
+	}
+
+	if (!generated.empty()) {
+		if (!updateFile(path, generated)) {
+			std::fprintf(stderr, "Could not update %s\n", path.c_str());
+			return 2;
+		}
+		std::printf("Added counts for %zu positions to %s\n", generated.size(), path.c_str());
+	}
+
+	std::printf("%llu nodes in %.3fs, %.0f nps, %zu failed\n", static_cast<unsigned long long>(totalNodes), totalSeconds,
+			totalSeconds > 0 ? totalNodes / totalSeconds : 0.0, failures);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,507 @@
+// Generates endgame tables of the wall-slide variant for a few pieces
+//
+// Usage: tablebase [options] <material>...
+//   --threads N  Threads the positions of each pass are split across, defaults to the hardware concurrency
+//   --dir DIR    Directory the tables are written to and read from, defaults to the current directory
+//
+// Materials are named like KQvK or KRvKP with white before the v. The tables of the endings a material
+// turns into by captures and promotions are made first, DTM tables already in the directory are reused.
+// Each material is written as a DTM table, NAME.p4tb, and a WDL table a quarter of its size, NAME.p4wdl.
+//
+// Every pass plays the moves of positions still unknown. Pass 0 finds the mates, odd passes find the wins
+// one ply further and even passes the losses. A solved position marks the positions that could have moved
+// into it, later passes only look at those and at positions waiting for a longer result of another table.
+// Passes go on until two passes over every unknown position find nothing new, what is left is a draw.
+
+#include <phase4/engine/board/position.h>
+#include <phase4/engine/board/position_moves.h>
+#include <phase4/engine/board/session.h>
+#include <phase4/engine/board/zobrist_hashing.h>
+#include <phase4/engine/common/piece_color.h>
+#include <phase4/engine/common/piece_type.h>
+#include <phase4/engine/common/square.h>
+#include <phase4/engine/moves/move.h>
+
+#include "packed_position.h"
+#include "tablebase.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace phase4::engine;
+
+namespace {
+
+using Material = board::Tablebase::Material;
+
+// Solves one material, the tables it turns into have to be in the tablebase already
+class Generator {
+public:
+	Generator(const board::Tablebase &tablebase, const Material &material, size_t threads) :
+			m_tablebase(tablebase), m_material(material), m_threads(std::max<size_t>(threads, 1)), m_count(material.size()), m_values(std::make_unique<std::atomic<uint8_t>[]>(m_count)),
+			m_wake(std::make_unique<std::atomic<uint8_t>[]>(m_count)) {
+		for (std::unique_ptr<std::atomic<uint64_t>[]> &marks : m_marks) {
+			marks = std::make_unique<std::atomic<uint64_t>[]>((m_count + 63) / 64);
+		}
+	}
+
+	// Passes 0 and 1 and the last two look at every unknown position, the others only at the marked ones
+	// A position found by one of the last two was missed by the marks and may hold more plies than its shortest mate
+	void run() {
+		size_t quiet = 0;
+		bool full = true;
+		for (size_t pass = 0; pass <= board::Tablebase::MAX_PLIES && quiet < 2; ++pass) {
+			m_pass = pass;
+			m_marked = 0;
+			const auto start = std::chrono::steady_clock::now();
+			size_t looked = 0;
+			const size_t found = solve(pass, full, looked);
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			std::printf("  pass %3zu %12zu %s %12zu looked at %9.3fs\n", pass, found, pass == 0 ? "mates " : pass % 2 == 1 ? "wins  " : "losses", looked, seconds);
+
+			std::atomic<uint64_t> *marks = m_marks[pass % 2].get();
+			std::fill(marks, marks + (m_count + 63) / 64, 0);
+
+			if (full && pass > 1 && found > 0) {
+				std::printf("  %zu positions were missed by the marks\n", found);
+			}
+			const bool pending = found > 0 || m_marked > 0 || m_lastWake.load() > pass;
+			quiet = !full || pending ? 0 : quiet + 1;
+			full = pass < 1 || !pending;
+		}
+	}
+
+	// Value of a position once run() returned, indexed like Tablebase::index()
+	uint8_t value(size_t index) const {
+		return m_values[index].load(std::memory_order_relaxed);
+	}
+
+	size_t size() const {
+		return m_count;
+	}
+
+	// Writes the table straight from the values, a chunk at a time rather than copying them all first
+	bool write(std::FILE *file, board::Tablebase::Format format) const {
+		if (!board::Tablebase::writeHeader(file, m_material, m_count, format)) {
+			return false;
+		}
+
+		std::array<uint8_t, CHUNK> chunk;
+		for (size_t begin = 0; begin < m_count; begin += CHUNK) {
+			const size_t count = std::min(CHUNK, m_count - begin);
+			if (format == board::Tablebase::WDL) {
+				chunk.fill(0);
+				for (size_t i = 0; i < count; ++i) {
+					chunk[i / 4] |= static_cast<uint8_t>(board::Tablebase::wdlOf(value(begin + i)) << (i % 4 * 2));
+				}
+			} else {
+				for (size_t i = 0; i < count; ++i) {
+					chunk[i] = value(begin + i);
+				}
+			}
+
+			const size_t bytes = board::Tablebase::bytes(format, count);
+			if (std::fwrite(chunk.data(), 1, bytes, file) != bytes) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+private:
+	static constexpr size_t CHUNK = 4096; // A multiple of 4 so WDL chunks end on a whole byte
+	static constexpr uint8_t UNKNOWN = board::Tablebase::DRAW_VALUE; // Until the last pass
+	static constexpr uint8_t NO_WAKE = 0;
+
+	// Splits the positions into chunks taken by the threads, each thread plays the moves with its own session
+	size_t solve(size_t pass, bool full, size_t &looked) {
+		std::atomic<size_t> next = 0;
+		std::atomic<size_t> found = 0;
+		std::atomic<size_t> visited = 0;
+		const std::atomic<uint64_t> *marks = m_marks[pass % 2].get();
+
+		std::vector<std::thread> workers;
+		for (size_t i = 0; i < m_threads; ++i) {
+			workers.emplace_back([&]() {
+				board::Session session;
+				size_t solved = 0;
+				size_t seen = 0;
+				for (size_t begin = (next += CHUNK) - CHUNK; begin < m_count; begin = (next += CHUNK) - CHUNK) {
+					for (size_t index = begin; index < std::min(begin + CHUNK, m_count); ++index) {
+						const bool marked = (marks[index / 64].load(std::memory_order_relaxed) >> (index % 64)) & 1;
+						if (!full && !marked && m_wake[index].load(std::memory_order_relaxed) != pass) {
+							continue;
+						}
+						if (m_values[index].load(std::memory_order_relaxed) != UNKNOWN) {
+							continue;
+						}
+						++seen;
+						solved += solvePosition(index, pass, session) ? 1 : 0;
+					}
+				}
+				found += solved;
+				visited += seen;
+			});
+		}
+
+		for (std::thread &worker : workers) {
+			worker.join();
+		}
+		looked = visited;
+		return found;
+	}
+
+	// Positions solved in this pass hold the pass as their plies, moves only count what was known before it
+	// Moves into other tables with results not known yet wake the position up again once they are
+	bool solvePosition(size_t index, size_t pass, board::Session &session) {
+		const std::optional<board::Position> position = positionAt(index);
+		if (!position) {
+			m_values[index].store(board::Tablebase::INVALID_VALUE, std::memory_order_relaxed);
+			return false;
+		}
+
+		moves::Moves validMoves;
+		board::PositionMoves::getValidMoves(*position, validMoves);
+		if (validMoves.size() == 0) {
+			if (pass == 0 && position->isKingChecked(position->colorToMove())) {
+				store(index, board::Tablebase::LOSS, 0);
+				return true;
+			}
+			return false; // Stalemates stay a draw
+		}
+		if (pass == 0) {
+			return false;
+		}
+
+		session.setPosition(*position);
+		const bool lookingForWin = pass % 2 == 1;
+		bool allWin = true;
+		size_t wake = NO_WAKE;
+		for (size_t i = 0; i < validMoves.size(); ++i) {
+			session.makeMove(validMoves[i]);
+			bool exit = false;
+			const std::optional<board::Tablebase::Result> next = resultOf(session.position(), exit);
+			session.undoMove(validMoves[i]);
+
+			// Results of the other side, known ones count once they are shorter than this pass
+			const bool known = next && next->wdl != board::Tablebase::DRAW && next->plies < pass;
+			if (lookingForWin && known && next->wdl == board::Tablebase::LOSS) {
+				store(index, board::Tablebase::WIN, pass);
+				return true;
+			}
+			if (!known || next->wdl != board::Tablebase::WIN) {
+				allWin = false;
+			}
+			if (exit && next && next->wdl != board::Tablebase::DRAW && next->plies >= pass && (wake == NO_WAKE || next->plies + 1u < wake)) {
+				wake = next->plies + 1u;
+			}
+		}
+
+		if (!lookingForWin && allWin) {
+			store(index, board::Tablebase::LOSS, pass);
+			return true;
+		}
+
+		m_wake[index].store(static_cast<uint8_t>(wake), std::memory_order_relaxed);
+		size_t lastWake = m_lastWake.load(std::memory_order_relaxed);
+		while (wake > lastWake && !m_lastWake.compare_exchange_weak(lastWake, wake)) {
+		}
+		return false;
+	}
+
+	void store(size_t index, board::Tablebase::Wdl wdl, size_t plies) {
+		board::Tablebase::Result result;
+		result.wdl = wdl;
+		result.plies = static_cast<uint8_t>(plies);
+		m_values[index].store(board::Tablebase::encode(result), std::memory_order_relaxed);
+		markPredecessors(index);
+	}
+
+	// Nothing while a position of this table is unknown, endings without a table are draws
+	// Exit is set for positions of other tables
+	std::optional<board::Tablebase::Result> resultOf(const board::Position &position, bool &exit) {
+		const std::optional<Material> material = Material::of(position);
+		if (material && *material == m_material) {
+			const std::optional<size_t> index = board::Tablebase::index(position, m_material);
+			if (!index) {
+				return board::Tablebase::Result();
+			}
+			const uint8_t value = m_values[*index].load(std::memory_order_relaxed);
+			return value == UNKNOWN ? std::nullopt : board::Tablebase::decode(value);
+		}
+
+		exit = true;
+		const std::optional<board::Tablebase::Result> result = m_tablebase.probe(position);
+		return result ? result : board::Tablebase::Result();
+	}
+
+	// Marks the positions of the table that could have moved into the solved one for the next pass
+	// The engine has no move generation backwards, a piece of the side that moved goes back any way it could move,
+	// with the walls sliding back a step before or after it or not at all. The passes only play the real moves forward.
+	void markPredecessors(size_t index) {
+		using namespace common;
+
+		board::Tablebase::Placement placement = board::Tablebase::placement(m_material, index);
+		placement.colorToMove = placement.colorToMove.invert();
+		unmove(placement);
+
+		const size_t lowest = board::WallSlides::lowestSquare(placement.walls);
+		for (const int8_t offset : board::WallSlides::OFFSETS) {
+			// The slide back to where the walls were, it pushes what the walls left on their old squares back
+			const board::WallSlides::Slide *slide = board::WallSlides::find(lowest, offset);
+			if (!slide) {
+				continue;
+			}
+
+			board::Tablebase::Placement slid = placement;
+			slid.walls = slide->to;
+			for (size_t i = 0; i < m_material.count; ++i) {
+				slid.squares[i] = static_cast<uint8_t>(board::WallSlides::lowestSquare(board::WallSlides::push(*slide, uint64_t(1) << slid.squares[i])));
+			}
+			mark(slid);
+			unmove(slid);
+
+			unmove(placement, slide);
+		}
+	}
+
+	// Marks the placement with one piece of the side to move taken back a move, slid back afterwards when a slide is given
+	void unmove(const board::Tablebase::Placement &placement, const board::WallSlides::Slide *slide = nullptr) {
+		using namespace common;
+
+		uint64_t occupancy = placement.walls;
+		for (size_t i = 0; i < m_material.count; ++i) {
+			occupancy |= uint64_t(1) << placement.squares[i];
+		}
+
+		for (size_t i = 0; i < m_material.count; ++i) {
+			const PieceColor color(static_cast<uint8_t>(m_material.pieces[i] >> 3));
+			if (color != placement.colorToMove) {
+				continue;
+			}
+
+			const size_t square = placement.squares[i];
+			uint64_t origins = 0;
+			if ((m_material.pieces[i] & 7) == PieceType::PAWN.get_raw_value()) {
+				const uint64_t back = color == PieceColor::WHITE ? (uint64_t(1) << square) >> 8 : (uint64_t(1) << square) << 8;
+				const size_t doubled = color == PieceColor::WHITE ? 3 : 4;
+				origins = back & ~occupancy;
+				if (origins != 0 && square / 8 == doubled) {
+					origins |= (color == PieceColor::WHITE ? back >> 8 : back << 8) & ~occupancy;
+				}
+			} else {
+				origins = board::AttackMaps::attacks(square, PieceType(static_cast<uint8_t>(m_material.pieces[i] & 7)), color, occupancy) & ~occupancy;
+			}
+
+			for (; origins != 0; origins &= origins - 1) {
+				board::Tablebase::Placement moved = placement;
+				moved.squares[i] = static_cast<uint8_t>(board::WallSlides::lowestSquare(origins));
+				if (slide) {
+					moved.walls = slide->to;
+					for (size_t j = 0; j < m_material.count; ++j) {
+						moved.squares[j] = static_cast<uint8_t>(board::WallSlides::lowestSquare(board::WallSlides::push(*slide, uint64_t(1) << moved.squares[j])));
+					}
+				}
+				mark(moved);
+			}
+		}
+	}
+
+	void mark(const board::Tablebase::Placement &placement) {
+		const std::optional<size_t> index = board::Tablebase::index(m_material, placement);
+		if (!index || m_values[*index].load(std::memory_order_relaxed) != UNKNOWN) {
+			return;
+		}
+
+		const uint64_t bit = uint64_t(1) << (*index % 64);
+		std::atomic<uint64_t> &marks = m_marks[(m_pass + 1) % 2][*index / 64];
+		if ((marks.fetch_or(bit, std::memory_order_relaxed) & bit) == 0) {
+			m_marked.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	// Nothing for placements that can not happen: pieces on the same square, pawns on the last ranks,
+	// copies of placements the table holds turned or mirrored or the king of the side not to move in check
+	std::optional<board::Position> positionAt(size_t index) const {
+		using namespace common;
+
+		const board::Tablebase::Placement placement = board::Tablebase::placement(m_material, index);
+
+		// Pieces are placed on an empty position, without castling rights or an en passant square
+		board::Position position;
+		uint64_t occupied = 0;
+		for (size_t i = 0; i < m_material.count; ++i) {
+			const uint8_t piece = m_material.pieces[i];
+			const uint8_t square = placement.squares[i];
+			const size_t rank = square / 8;
+			if ((occupied & (uint64_t(1) << square)) != 0 || ((piece & 7) == PieceType::PAWN.get_raw_value() && (rank == 0 || rank == 7))) {
+				return {};
+			}
+
+			occupied |= uint64_t(1) << square;
+			position.addPiece(PieceColor(static_cast<uint8_t>(piece >> 3)), PieceType(static_cast<uint8_t>(piece & 7)), Square(static_cast<size_t>(square)));
+		}
+		position.colorToMove() = placement.colorToMove;
+		position.hash() = board::ZobristHashing::calculateHash(position);
+
+		if (!board::PackedPosition::placeWalls(position, Square(board::WallSlides::lowestSquare(placement.walls))) ||
+				board::Tablebase::index(position, m_material) != index || position.isKingChecked(placement.colorToMove.invert())) {
+			return {};
+		}
+		return position;
+	}
+
+	const board::Tablebase &m_tablebase;
+	Material m_material;
+	size_t m_threads;
+	size_t m_count;
+	std::unique_ptr<std::atomic<uint8_t>[]> m_values;
+	std::unique_ptr<std::atomic<uint8_t>[]> m_wake; // Pass a result of another table becomes usable, NO_WAKE for none
+	std::array<std::unique_ptr<std::atomic<uint64_t>[]>, 2> m_marks; // Bits of the positions to look at, by pass parity
+	std::atomic<size_t> m_marked = 0; // Marks for the next pass
+	std::atomic<size_t> m_lastWake = 0;
+	size_t m_pass = 0;
+};
+
+// The materials captures and promotions of the pieces lead to, smallest first so each table finds the ones it needs
+std::vector<Material> dependencies(const std::vector<Material> &requested) {
+	using namespace common;
+
+	std::vector<Material> materials;
+	std::vector<Material> pending = requested;
+	while (!pending.empty()) {
+		const Material material = pending.back();
+		pending.pop_back();
+		if (material.count < 3 || std::find(materials.begin(), materials.end(), material) != materials.end()) {
+			continue;
+		}
+		materials.push_back(material);
+
+		const std::string name = material.name();
+		for (size_t i = 0; i < name.size(); ++i) {
+			if (name[i] == 'K' || name[i] == 'v') {
+				continue;
+			}
+
+			if (const std::optional<Material> captured = Material::parse(name.substr(0, i) + name.substr(i + 1))) {
+				pending.push_back(*captured);
+			}
+			if (name[i] == 'P') {
+				for (const char promotion : { 'N', 'B', 'R', 'Q' }) {
+					if (const std::optional<Material> promoted = Material::parse(name.substr(0, i) + promotion + name.substr(i + 1))) {
+						pending.push_back(*promoted);
+					}
+				}
+			}
+		}
+	}
+
+	const auto pawns = [](const Material &material) {
+		return std::count_if(material.pieces.begin(), material.pieces.begin() + material.count, [](uint8_t piece) {
+			return (piece & 7) == PieceType::PAWN.get_raw_value();
+		});
+	};
+	std::sort(materials.begin(), materials.end(), [&](const Material &a, const Material &b) {
+		return a.count != b.count ? a.count < b.count : pawns(a) < pawns(b);
+	});
+	return materials;
+}
+
+void usage() {
+	std::fprintf(stderr, "Usage: tablebase [--threads N] [--dir DIR] <material>...\n");
+}
+
+} //namespace
+
+int main(int argc, char **argv) {
+	size_t threads = std::max(1u, std::thread::hardware_concurrency());
+	std::string directory = ".";
+	std::vector<Material> requested;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (arg == "--threads" && hasValue) {
+			threads = std::strtoull(argv[++i], nullptr, 10);
+		} else if (arg == "--dir" && hasValue) {
+			directory = argv[++i];
+		} else if (arg[0] != '-') {
+			const std::optional<Material> material = Material::parse(arg);
+			if (!material || material->count > board::Tablebase::MAX_PIECES) {
+				std::fprintf(stderr, "Invalid material %s, up to %zu pieces with one king each\n", arg.c_str(), board::Tablebase::MAX_PIECES);
+				return 2;
+			}
+			requested.push_back(*material);
+		} else {
+			usage();
+			return 2;
+		}
+	}
+
+	if (requested.empty()) {
+		usage();
+		return 2;
+	}
+
+	board::Tablebase tablebase;
+	for (const Material &material : dependencies(requested)) {
+		const std::string path = directory + "/" + material.name() + ".p4tb";
+		const std::string wdlPath = directory + "/" + material.name() + ".p4wdl";
+		if (tablebase.open(path.c_str())) {
+			std::printf("%s: reusing %s\n", material.name().c_str(), path.c_str());
+			continue;
+		}
+
+		std::printf("%s: %zu positions\n", material.name().c_str(), material.size());
+		const auto start = std::chrono::steady_clock::now();
+		Generator generator(tablebase, material, threads);
+		generator.run();
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		size_t wins = 0;
+		size_t losses = 0;
+		size_t draws = 0;
+		size_t longest = 0;
+		for (size_t i = 0; i < generator.size(); ++i) {
+			const std::optional<board::Tablebase::Result> result = board::Tablebase::decode(generator.value(i));
+			if (!result) {
+				continue;
+			}
+			wins += result->wdl == board::Tablebase::WIN ? 1 : 0;
+			losses += result->wdl == board::Tablebase::LOSS ? 1 : 0;
+			draws += result->wdl == board::Tablebase::DRAW ? 1 : 0;
+			longest = std::max<size_t>(longest, result->plies);
+		}
+		std::printf("%s: %zu wins, %zu losses, %zu draws, longest mate %zu plies in %.3fs\n", material.name().c_str(), wins, losses, draws, longest, seconds);
+
+		for (const board::Tablebase::Format format : { board::Tablebase::DTM, board::Tablebase::WDL }) {
+			const std::string &outputPath = format == board::Tablebase::DTM ? path : wdlPath;
+			std::FILE *output = std::fopen(outputPath.c_str(), "wb");
+			if (!output) {
+				std::fprintf(stderr, "Could not create %s\n", outputPath.c_str());
+				return 2;
+			}
+			const bool written = generator.write(output, format);
+			if (std::fclose(output) != 0 || !written) {
+				std::fprintf(stderr, "Could not write %s\n", outputPath.c_str());
+				return 2;
+			}
+		}
+
+		// Only the DTM table is used for the materials after it, their distances to mate build on it
+		if (!tablebase.open(path.c_str())) {
+			std::fprintf(stderr, "Could not read %s\n", path.c_str());
+			return 2;
+		}
+	}
+	return 0;
+}